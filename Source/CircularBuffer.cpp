@@ -0,0 +1,93 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Allen Institute for Brain Science and Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "CircularBuffer.h"
+
+/* Ranges lock_memory_pages() has pinned, for relock_memory_pages() */
+static std::mutex lockedRangesMutex;
+static std::vector<std::pair<const void*, size_t>> lockedRanges;
+
+static bool lock_range(const void* address, size_t numBytes)
+{
+#ifdef _WIN32
+	if (VirtualLock(const_cast<void*>(address), numBytes))
+		return true;
+
+	// The default working set is too small to lock more than a few pages;
+	// grow it by the size of this buffer and try again
+	SIZE_T minSize, maxSize;
+	HANDLE process = GetCurrentProcess();
+
+	if (!GetProcessWorkingSetSize(process, &minSize, &maxSize))
+		return false;
+
+	if (!SetProcessWorkingSetSize(process, minSize + numBytes, maxSize + numBytes))
+		return false;
+
+	return VirtualLock(const_cast<void*>(address), numBytes) != 0;
+#else
+	return mlock(address, numBytes) == 0;
+#endif
+}
+
+bool lock_memory_pages(const void* address, size_t numBytes)
+{
+	if (!lock_range(address, numBytes))
+		return false;
+
+	std::lock_guard<std::mutex> lock(lockedRangesMutex);
+	lockedRanges.emplace_back(address, numBytes);
+	return true;
+}
+
+bool relock_memory_pages()
+{
+	std::lock_guard<std::mutex> lock(lockedRangesMutex);
+	bool allLocked = true;
+
+	for (const auto& range : lockedRanges)
+		allLocked = lock_range(range.first, range.second) && allLocked;
+
+	return allLocked;
+}
+
+void unlock_memory_pages(const void* address, size_t numBytes)
+{
+	{
+		std::lock_guard<std::mutex> lock(lockedRangesMutex);
+		lockedRanges.erase(std::remove(lockedRanges.begin(), lockedRanges.end(), std::make_pair(address, numBytes)), lockedRanges.end());
+	}
+
+#ifdef _WIN32
+	VirtualUnlock(const_cast<void*>(address), numBytes);
+#else
+	munlock(address, numBytes);
+#endif
+}
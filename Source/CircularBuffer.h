@@ -1,44 +1,478 @@
-#include <iostream>
-#include <thread>
+#ifndef __CIRCULARBUFFER_H__
+#define __CIRCULARBUFFER_H__
+
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+/* Pins / unpins the pages of a memory range in RAM (CircularBuffer.cpp) */
+bool lock_memory_pages(const void* address, size_t numBytes);
+void unlock_memory_pages(const void* address, size_t numBytes);
+
+/* Pins every range lock_memory_pages() holds again, after munlockall()
+   dropped them. Returns false if the OS refused any of them. */
+bool relock_memory_pages();
+
+/* What write() does when the buffer cannot hold the incoming frames */
+enum class OverrunPolicy {
+    DROP_OLDEST = 0,    // discard unread frames; latency stays bounded by the capacity
+    DROP_NEWEST,        // discard the incoming frames that do not fit
+    BLOCK               // wait for the consumer, then drop the newest frames on timeout; not for real-time producers
+};
+
+/* What read() does when fewer frames are available than requested */
+enum class UnderrunPolicy {
+    ZERO_FILL = 0,      // pad the missing frames with zeros
+    HOLD_LAST,          // pad the missing frames with the last frame read
+    WAIT                // return nothing until enough frames have arrived
+};
+
+/* How the channels of a multi-channel buffer are arranged in storage */
+enum class BufferLayout {
+    INTERLEAVED = 0,    // frame after frame, as DAQmx_Val_GroupByScanNumber
+    PLANAR              // one ring per channel, each starting on a cache line, as DAQmx_Val_GroupByChannel
+};
 
+/*
+    Wait-free single-producer/single-consumer ring buffer of frames.
+
+    A frame holds one sample for each of the buffer's channels. All indices,
+    counts and capacities are in frames, so a read or write can never split
+    a scan across channels. With a single channel both layouts coincide and
+    a frame is just a sample.
+
+    The capacity is rounded up to a power of two so that positions are found
+    by masking, and storage starts on a 64-byte boundary. lock_memory() pins
+    the storage in RAM so the consumer never takes a page fault mid-stream.
+
+    write() must only ever be called from one thread (the audio thread) and
+    read() from one other thread (the NIDAQmx writer). read_index and
+    write_index are free-running counters: their difference is the fill
+    level, and they are only masked down to a storage position when
+    touching storage, once per call.
+
+    The consumer may sleep while waiting for data. The producer never takes
+    the consumer's mutex; it only signals the condition variable when the
+    consumer has announced that it is waiting. Because that signal can race
+    with the consumer going to sleep, the consumer waits in short slices and
+    re-checks the fill level, which bounds the cost of a missed wake-up.
+
+    With OverrunPolicy::DROP_OLDEST the producer advances read_index itself.
+    The consumer therefore claims what it copied with a compare-exchange and
+    discards the copy if the producer overwrote those frames in the meantime.
+
+    Besides the copying write()/read(), the buffer can be accessed in place:
+    the producer fills the region returned by reserve() and publishes it with
+    commit(); the consumer uses the region returned by peek() and frees it
+    with release(). A region is split in two spans where it wraps around the
+    end of the storage. An interleaved span is a ready-made scan-ordered
+    array; a planar span gives each channel's samples as one contiguous run.
+*/
 template <typename T>
 class CircularBuffer {
 public:
-    CircularBuffer(size_t size) : buffer(size), read_index(0), write_index(0), size(size) {}
+    /* A contiguous run of frames in the buffer's storage */
+    struct Span {
+        T* data = nullptr;          // first sample of channel 0
+        size_t size = 0;            // number of frames
+        size_t channel_stride = 1;  // distance between the channels of one frame
+        size_t frame_stride = 1;    // distance between consecutive frames of one channel
 
-    void write(const T* data, size_t numSamples) {
-        std::unique_lock<std::mutex> lock(mutex);
-        for (size_t i = 0; i < numSamples; i++) {
-            buffer[write_index] = data[i];
-            write_index = (write_index + 1) % size;
+        T* get_channel(int channel) const { return data + channel * channel_stride; }
+    };
+
+    /* Up to two spans covering a range of frames, in order */
+    struct Region {
+        Span first;
+        Span second;
+        size_t position = 0;        // free-running index of the first frame
+        size_t size() const { return first.size + second.size; }
+    };
+
+    CircularBuffer(size_t numFrames, int numChannels = 1, BufferLayout layout = BufferLayout::INTERLEAVED)
+        : size(next_power_of_two(numFrames)), size_mask(size - 1), num_channels(numChannels), layout(layout),
+          last_frame(numChannels), read_index(0), write_index(0) {
+
+        if (layout == BufferLayout::PLANAR) {
+            // Each channel's ring starts on its own cache line
+            const size_t perLine = std::max<size_t>(1, cache_line_size / sizeof(T));
+            channel_stride = (size + perLine - 1) / perLine * perLine;
+            frame_stride = 1;
+        } else {
+            channel_stride = 1;
+            frame_stride = num_channels;
         }
-        cv.notify_one();
+
+        storage_size = layout == BufferLayout::PLANAR ? channel_stride * num_channels : size * num_channels;
+        storage = static_cast<T*>(::operator new(storage_size * sizeof(T), std::align_val_t(cache_line_size)));
+
+        // Value-initialising also touches every page up front
+        std::uninitialized_value_construct_n(storage, storage_size);
+    }
+
+    ~CircularBuffer() {
+        if (memory_locked)
+            unlock_memory_pages(storage, storage_size * sizeof(T));
+        std::destroy_n(storage, storage_size);
+        ::operator delete(storage, std::align_val_t(cache_line_size));
     }
 
-    void read(T* data, size_t numSamples) {
+    CircularBuffer(const CircularBuffer&) = delete;
+    CircularBuffer& operator=(const CircularBuffer&) = delete;
+
+    /* Pins the storage in physical memory. Returns false if the OS refused
+       (e.g. RLIMIT_MEMLOCK on Linux); the buffer stays usable either way. */
+    bool lock_memory() {
+        if (!memory_locked)
+            memory_locked = lock_memory_pages(storage, storage_size * sizeof(T));
+        return memory_locked;
+    }
+
+    bool is_memory_locked() const { return memory_locked; }
+
+    /* Copies numFrames interleaved frames into the buffer, applying the overrun
+       policy if they do not fit. Returns how many of the frames were stored. */
+    size_t write(const T* data, size_t numFrames) {
+        if (overrun_policy == OverrunPolicy::DROP_OLDEST && numFrames > size) {
+            // Only the most recent frames can survive
+            note_overrun(numFrames - size);
+            data += (numFrames - size) * num_channels;
+            numFrames = size;
+        }
+
+        Region region = reserve(numFrames);
+        copy_in(region.first, data, 1, num_channels);
+        copy_in(region.second, data + region.first.size * num_channels, 1, num_channels);
+        commit(region.size());
+
+        return region.size();
+    }
+
+    /* As above, taking one array of numFrames samples per channel */
+    size_t write(const T* const* channels, size_t numFrames) {
+        size_t offset = 0;
+        if (overrun_policy == OverrunPolicy::DROP_OLDEST && numFrames > size) {
+            note_overrun(numFrames - size);
+            offset = numFrames - size;
+            numFrames = size;
+        }
+
+        Region region = reserve(numFrames);
+        for (int c = 0; c < num_channels; c++) {
+            copy_channel_in(region.first, c, channels[c] + offset);
+            copy_channel_in(region.second, c, channels[c] + offset + region.first.size);
+        }
+        commit(region.size());
+
+        return region.size();
+    }
+
+    /* Producer: makes room for numFrames according to the overrun policy and
+       returns the writable region at the write position. The region is shorter
+       than requested if the policy dropped some of the incoming frames. */
+    Region reserve(size_t numFrames) {
+        size_t count = std::min(numFrames, size);
+
+        switch (overrun_policy) {
+        case OverrunPolicy::DROP_OLDEST:
+            make_room(count);
+            break;
+        case OverrunPolicy::BLOCK:
+            count = wait_for_space(count);
+            break;
+        case OverrunPolicy::DROP_NEWEST:
+        default:
+            count = std::min(count, get_free_space());
+            break;
+        }
+
+        if (count < numFrames)
+            note_overrun(numFrames - count);
+
+        return region_at(write_index.load(std::memory_order_relaxed), count);
+    }
+
+    /* Producer: publishes the first numFrames of the last reserved region */
+    void commit(size_t numFrames) {
+        write_index.store(write_index.load(std::memory_order_relaxed) + numFrames, std::memory_order_release);
+        wake_consumer();
+    }
+
+    /* Consumer: returns the readable region at the read position, at most
+       maxFrames long. Does not wait; see wait_for_frames(). */
+    Region peek(size_t maxFrames) {
+        peek_index = read_index.load(std::memory_order_acquire);
+        const size_t available = write_index.load(std::memory_order_acquire) - peek_index;
+
+        return region_at(peek_index, std::min(maxFrames, available));
+    }
+
+    /* Consumer: frees the first numFrames of the last peeked region. Returns
+       false if the producer dropped them (DROP_OLDEST) while they were in use,
+       in which case the region may have held newer frames. */
+    bool release(size_t numFrames) {
+        size_t tail = peek_index;
+        return read_index.compare_exchange_strong(tail, peek_index + numFrames, std::memory_order_acq_rel);
+    }
+
+    /* Waits up to timeoutMs (negative = forever) until numFrames can be read */
+    bool wait_for_frames(size_t numFrames, int timeoutMs) {
+        if (get_num_available() >= numFrames)
+            return true;
+
+        if (timeoutMs == 0)
+            return false;
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
         std::unique_lock<std::mutex> lock(mutex);
-        cv.wait(lock, [this, numSamples] { return (write_index + size - read_index) % size >= numSamples; });
-        for (int i = 0; i < numSamples; i++) {
-            data[i] = buffer[read_index];
-            read_index = (read_index + 1) % size;
+        consumer_waiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        bool ready;
+        while (!(ready = get_num_available() >= numFrames)) {
+            auto wakeup = std::chrono::steady_clock::now() + std::chrono::milliseconds(wait_slice_ms);
+            if (timeoutMs >= 0) {
+                if (std::chrono::steady_clock::now() >= deadline)
+                    break;
+                wakeup = std::min(wakeup, deadline);
+            }
+            cv.wait_until(lock, wakeup);
         }
+
+        consumer_waiting.store(false, std::memory_order_relaxed);
+        return ready;
     }
 
-    size_t get_write_index() {
-        std::lock_guard<std::mutex> lock(mutex);
-        return write_index;
+    /* Reads numFrames, waiting up to timeoutMs (negative = forever) for them to
+       arrive. If they do not, WAIT returns false without consuming anything;
+       ZERO_FILL and HOLD_LAST return whatever was there followed by padding.
+       data is filled in the buffer's own layout: scan by scan when interleaved,
+       or numFrames samples of channel 0, then of channel 1, ... when planar. */
+    bool read(T* data, size_t numFrames, int timeoutMs = -1) {
+        if (!wait_for_frames(numFrames, timeoutMs) && underrun_policy == UnderrunPolicy::WAIT) {
+            underruns.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        const size_t destChannelStride = layout == BufferLayout::PLANAR ? numFrames : 1;
+        const size_t destFrameStride = layout == BufferLayout::PLANAR ? 1 : num_channels;
+
+        size_t count;
+        size_t tail = read_index.load(std::memory_order_acquire);
+
+        do {
+            count = std::min(numFrames, write_index.load(std::memory_order_acquire) - tail);
+            Region region = region_at(tail, count);
+            copy_out(region.first, data, destChannelStride, destFrameStride);
+            copy_out(region.second, data + region.first.size * destFrameStride, destChannelStride, destFrameStride);
+        } while (!read_index.compare_exchange_weak(tail, tail + count, std::memory_order_acq_rel, std::memory_order_acquire));
+
+        for (int c = 0; c < num_channels && count > 0; c++)
+            last_frame[c] = data[c * destChannelStride + (count - 1) * destFrameStride];
+
+        if (count < numFrames) {
+            for (int c = 0; c < num_channels; c++) {
+                const T pad = underrun_policy == UnderrunPolicy::HOLD_LAST ? last_frame[c] : T();
+                for (size_t i = count; i < numFrames; i++)
+                    data[c * destChannelStride + i * destFrameStride] = pad;
+            }
+            underruns.fetch_add(1, std::memory_order_relaxed);
+            padded_frames.fetch_add(numFrames - count, std::memory_order_relaxed);
+        }
+
+        return true;
+    }
+
+    /* Policies may only be changed while neither thread is using the buffer */
+    void set_overrun_policy(OverrunPolicy policy, int blockTimeoutMs = 10) {
+        overrun_policy = policy;
+        block_timeout_ms = blockTimeoutMs;
+    }
+    OverrunPolicy get_overrun_policy() const { return overrun_policy; }
+
+    void set_underrun_policy(UnderrunPolicy policy) { underrun_policy = policy; }
+    UnderrunPolicy get_underrun_policy() const { return underrun_policy; }
+
+    /* Number of writes that could not be stored as-is, and the frames lost to them */
+    uint64_t get_num_overruns() const { return overruns.load(std::memory_order_relaxed); }
+    uint64_t get_num_dropped_frames() const { return dropped_frames.load(std::memory_order_relaxed); }
+
+    /* Number of reads that found too few frames, and the frames padded in by them */
+    uint64_t get_num_underruns() const { return underruns.load(std::memory_order_relaxed); }
+    uint64_t get_num_padded_frames() const { return padded_frames.load(std::memory_order_relaxed); }
+
+    /* Consumer: counts an underrun the caller handled itself when the region
+       it peeked was lost to the producer, e.g. by repeating a frame or by
+       skipping the chunk; paddedFrames is how many frames it made up or lost */
+    void note_underrun(size_t paddedFrames) {
+        underruns.fetch_add(1, std::memory_order_relaxed);
+        padded_frames.fetch_add(paddedFrames, std::memory_order_relaxed);
+    }
+
+    void reset_counters() {
+        overruns = 0;
+        dropped_frames = 0;
+        underruns = 0;
+        padded_frames = 0;
     }
 
-    size_t get_read_index() {
-        std::lock_guard<std::mutex> lock(mutex);
-        return read_index;
+    /* Number of frames that can be read right now */
+    size_t get_num_available() const {
+        const size_t tail = read_index.load(std::memory_order_acquire);
+        return write_index.load(std::memory_order_acquire) - tail;
     }
 
+    size_t get_free_space() const { return size - get_num_available(); }
+
+    size_t get_capacity() const { return size; }
+    int get_num_channels() const { return num_channels; }
+    BufferLayout get_layout() const { return layout; }
+
+    size_t get_write_index() const { return write_index.load(std::memory_order_acquire) & size_mask; }
+    size_t get_read_index() const { return read_index.load(std::memory_order_acquire) & size_mask; }
+
+    /* Free-running frame counts: frames ever written / consumed (or dropped) */
+    size_t get_write_position() const { return write_index.load(std::memory_order_acquire); }
+    size_t get_read_position() const { return read_index.load(std::memory_order_acquire); }
+
 private:
-    std::vector<T> buffer;
-    size_t read_index, write_index, size;
+    static size_t next_power_of_two(size_t n) {
+        size_t p = 1;
+        while (p < n)
+            p <<= 1;
+        return p;
+    }
+
+    Region region_at(size_t position, size_t count) const {
+        const size_t start = position & size_mask;
+        const size_t first = std::min(count, size - start);
+        return Region { span_at(start, first), span_at(0, count - first), position };
+    }
+
+    Span span_at(size_t frame, size_t count) const {
+        return Span { storage + frame * frame_stride, count, channel_stride, frame_stride };
+    }
+
+    /* Copies span.size frames from src, whose samples are srcChannelStride
+       apart within a frame and srcFrameStride apart between frames */
+    void copy_in(const Span& span, const T* src, size_t srcChannelStride, size_t srcFrameStride) {
+        if (span.frame_stride == srcFrameStride && (num_channels == 1 || (span.channel_stride == 1 && srcChannelStride == 1))) {
+            std::copy(src, src + span.size * num_channels, span.data);
+            return;
+        }
+        for (int c = 0; c < num_channels; c++) {
+            T* dest = span.get_channel(c);
+            for (size_t i = 0; i < span.size; i++)
+                dest[i * span.frame_stride] = src[c * srcChannelStride + i * srcFrameStride];
+        }
+    }
+
+    /* Copies span.size contiguous samples of one channel from src */
+    void copy_channel_in(const Span& span, int channel, const T* src) {
+        T* dest = span.get_channel(channel);
+        if (span.frame_stride == 1) {
+            std::copy(src, src + span.size, dest);
+            return;
+        }
+        for (size_t i = 0; i < span.size; i++)
+            dest[i * span.frame_stride] = src[i];
+    }
+
+    /* Copies span.size frames into dest with the given strides */
+    void copy_out(const Span& span, T* dest, size_t destChannelStride, size_t destFrameStride) const {
+        if (span.frame_stride == destFrameStride && (num_channels == 1 || (span.channel_stride == 1 && destChannelStride == 1))) {
+            std::copy(span.data, span.data + span.size * num_channels, dest);
+            return;
+        }
+        for (int c = 0; c < num_channels; c++) {
+            const T* src = span.get_channel(c);
+            for (size_t i = 0; i < span.size; i++)
+                dest[c * destChannelStride + i * destFrameStride] = src[i * span.frame_stride];
+        }
+    }
+
+    void note_overrun(size_t numDropped) {
+        overruns.fetch_add(1, std::memory_order_relaxed);
+        dropped_frames.fetch_add(numDropped, std::memory_order_relaxed);
+    }
+
+    /* DROP_OLDEST: advance read_index so that count more frames fit */
+    void make_room(size_t count) {
+        const size_t head = write_index.load(std::memory_order_relaxed);
+        size_t tail = read_index.load(std::memory_order_acquire);
+
+        while (head + count - tail > size) {
+            const size_t excess = head + count - tail - size;
+            if (read_index.compare_exchange_weak(tail, tail + excess, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                note_overrun(excess);
+                break;
+            }
+        }
+    }
+
+    /* BLOCK: wait up to block_timeout_ms for the consumer; returns how many fit */
+    size_t wait_for_space(size_t count) {
+        count = std::min(count, size);
+        if (get_free_space() >= count)
+            return count;
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(block_timeout_ms);
+        while (get_free_space() < count && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::yield();
+
+        return std::min(count, get_free_space());
+    }
+
+    void wake_consumer() {
+        // Pairs with the fence in wait_for_frames: either the consumer sees the
+        // new write_index, or we see consumer_waiting and signal it.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (consumer_waiting.load(std::memory_order_relaxed))
+            cv.notify_one();
+    }
+
+    static constexpr int wait_slice_ms = 1;
+    static constexpr size_t cache_line_size = 64;
+
+    T* storage = nullptr;
+    size_t storage_size = 0;
+    bool memory_locked = false;
+
+    const size_t size;
+    const size_t size_mask;
+    const int num_channels;
+    const BufferLayout layout;
+    size_t channel_stride;
+    size_t frame_stride;
+
+    OverrunPolicy overrun_policy = OverrunPolicy::DROP_OLDEST;
+    UnderrunPolicy underrun_policy = UnderrunPolicy::WAIT;
+    int block_timeout_ms = 10;
+
+    // Only touched by the consumer
+    std::vector<T> last_frame;
+    size_t peek_index = 0;
+
+    // Producer and consumer indices live on separate cache lines
+    alignas(64) std::atomic<size_t> read_index;
+    alignas(64) std::atomic<size_t> write_index;
+    alignas(64) std::atomic<bool> consumer_waiting { false };
+
+    std::atomic<uint64_t> overruns { 0 };
+    std::atomic<uint64_t> dropped_frames { 0 };
+    std::atomic<uint64_t> underruns { 0 };
+    std::atomic<uint64_t> padded_frames { 0 };
+
     std::mutex mutex;
     std::condition_variable cv;
-};
\ No newline at end of file
+};
+
+#endif  // __CIRCULARBUFFER_H__
@@ -0,0 +1,142 @@
+#ifndef __COMMANDQUEUE_H__
+#define __COMMANDQUEUE_H__
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+
+/*
+    Lock-free bounded multi-producer/single-consumer queue of small commands.
+
+    Any number of threads may push(); one thread pops. Every slot carries a
+    sequence number that tells producers and the consumer whose turn it is:
+    a producer claims a slot by advancing the shared tail with a
+    compare-exchange, fills it, then publishes it by bumping the slot's
+    sequence. The consumer only ever reads slots that have been published,
+    in the order they were claimed. No thread ever waits for another inside
+    push() or pop(); a full queue makes push() fail instead.
+
+    The capacity is rounded up to a power of two. As with CircularBuffer,
+    the consumer may sleep in wait_for_command(); producers only signal it
+    when it has announced that it is waiting, and it waits in short slices
+    to bound the cost of a missed wake-up.
+*/
+template <typename T>
+class CommandQueue {
+public:
+    explicit CommandQueue(size_t capacity)
+        : size(next_power_of_two(capacity)), size_mask(size - 1), slots(new Slot[size]) {
+        for (size_t i = 0; i < size; i++)
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    CommandQueue(const CommandQueue&) = delete;
+    CommandQueue& operator=(const CommandQueue&) = delete;
+
+    /* Any thread. Returns false, dropping the command, if the queue is full */
+    bool push(const T& command) {
+        size_t position = tail.load(std::memory_order_relaxed);
+
+        while (true) {
+            Slot& slot = slots[position & size_mask];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t difference = std::ptrdiff_t(sequence) - std::ptrdiff_t(position);
+
+            if (difference == 0) {
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.command = command;
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    wake_consumer();
+                    return true;
+                }
+            } else if (difference < 0) {
+                // The consumer hasn't freed this slot from the previous lap yet
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /* Consumer only. Returns false if no command has been published yet */
+    bool pop(T& command) {
+        Slot& slot = slots[head & size_mask];
+
+        if (slot.sequence.load(std::memory_order_acquire) != head + 1)
+            return false;
+
+        command = slot.command;
+        slot.sequence.store(head + size, std::memory_order_release);
+        head++;
+        return true;
+    }
+
+    /* Consumer only. Waits up to timeoutMs for a command to be published */
+    bool wait_for_command(int timeoutMs) {
+        if (is_ready())
+            return true;
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        consumer_waiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        bool ready;
+        while (!(ready = is_ready()) && std::chrono::steady_clock::now() < deadline)
+            cv.wait_until(lock, std::min(deadline, std::chrono::steady_clock::now() + std::chrono::milliseconds(wait_slice_ms)));
+
+        consumer_waiting.store(false, std::memory_order_relaxed);
+        return ready;
+    }
+
+    size_t get_capacity() const { return size; }
+
+    /* Commands push() turned away because the queue was full */
+    size_t get_num_dropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T command;
+    };
+
+    bool is_ready() const {
+        return slots[head & size_mask].sequence.load(std::memory_order_acquire) == head + 1;
+    }
+
+    void wake_consumer() {
+        // Pairs with the fence in wait_for_command
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (consumer_waiting.load(std::memory_order_relaxed))
+            cv.notify_one();
+    }
+
+    static size_t next_power_of_two(size_t n) {
+        size_t power = 1;
+        while (power < n)
+            power <<= 1;
+        return power;
+    }
+
+    static constexpr int wait_slice_ms = 1;
+
+    const size_t size;
+    const size_t size_mask;
+    std::unique_ptr<Slot[]> slots;
+
+    alignas(64) std::atomic<size_t> tail { 0 };
+    alignas(64) size_t head = 0;
+    alignas(64) std::atomic<bool> consumer_waiting { false };
+    std::atomic<size_t> dropped { 0 };
+
+    std::mutex mutex;
+    std::condition_variable cv;
+};
+
+#endif  // __COMMANDQUEUE_H__
@@ -45,6 +45,50 @@ AnalogOutput::AnalogOutput(String name, NIDAQ::int32 termCfgs) : OutputChannel(n
 
 }
 
+bool AnalogOutput::setRouting(String expression)
+{
+
+	std::vector<RoutingTerm> terms;
+	String remaining = expression.removeCharacters(" \t").toLowerCase();
+
+	while (remaining.isNotEmpty())
+	{
+		float sign = 1.0f;
+		if (remaining[0] == '+' || remaining[0] == '-')
+		{
+			sign = remaining[0] == '-' ? -1.0f : 1.0f;
+			remaining = remaining.substring(1);
+		}
+
+		// Each term is [weight[*]]ch<number>
+		int end = remaining.indexOfAnyOf("+-");
+		String term = end < 0 ? remaining : remaining.substring(0, end);
+		remaining = end < 0 ? String() : remaining.substring(end);
+
+		int channelStart = term.indexOf("ch");
+		if (channelStart < 0)
+			return false;
+
+		String weightText = term.substring(0, channelStart).trimCharactersAtEnd("*");
+		String channelText = term.substring(channelStart + 2);
+
+		if (channelText.isEmpty() || !channelText.containsOnly("0123456789") || !weightText.containsOnly("0123456789."))
+			return false;
+
+		int channel = channelText.getIntValue() - 1;
+		if (channel < 0)
+			return false;
+
+		terms.push_back({ channel, sign * (weightText.isEmpty() ? 1.0f : weightText.getFloatValue()) });
+	}
+
+	routing = terms;
+	routingExpression = expression.trim();
+
+	return true;
+
+}
+
 static int32 GetTerminalNameWithDevPrefix(NIDAQ::TaskHandle taskHandle, const char terminalName[], char triggerName[]);
 
 static int32 GetTerminalNameWithDevPrefix(NIDAQ::TaskHandle taskHandle, const char terminalName[], char triggerName[])
@@ -114,6 +158,112 @@ int NIDAQmxDeviceManager::getDeviceIndexFromName(String name)
 
 }
 
+DigitalOutputThread::DigitalOutputThread(NIDAQmx* nidaq_)
+	: Thread("NIDAQmx-DO-" + nidaq_->device->getName()), nidaq(nidaq_)
+{
+}
+
+void DigitalOutputThread::run()
+{
+
+	// Longest a change waits for the end of its processing block (changes queued outside process())
+	const double maxBlockWaitMs = 10.0;
+
+	const int numPorts = int(nidaq->digitalPortTasks.size());
+
+	// Lines of each port with a change waiting to be written; the new word is in digitalPortWords
+	std::vector<NIDAQ::uInt32> changedLines(numPorts, 0);
+	int numPendingChanges = 0;
+	int64 firstQueuedTicks = 0;
+	bool blockEnded = false;
+
+	// One driver call per port with changes
+	auto writePendingChanges = [&]()
+	{
+		const int64 startTicks = Time::getHighResolutionTicks();
+		const double queueMs = 1000.0 * Time::highResolutionTicksToSeconds(startTicks - firstQueuedTicks);
+
+		for (int port = 0; port < numPorts; port++)
+		{
+			if (changedLines[port] == 0)
+				continue;
+
+			const int64 writeStartTicks = Time::getHighResolutionTicks();
+
+			nidaq->writeDigitalPort(port);
+
+			const double writeMs = 1000.0 * Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - writeStartTicks);
+
+			nidaq->lastDigitalWriteMs = writeMs;
+			nidaq->maxDigitalWriteMs = jmax(nidaq->maxDigitalWriteMs.load(), writeMs);
+			nidaq->totalDigitalWriteMs += writeMs;
+			nidaq->numDigitalWrites++;
+
+			changedLines[port] = 0;
+		}
+
+		nidaq->lastDigitalQueueMs = queueMs;
+		nidaq->maxDigitalQueueMs = jmax(nidaq->maxDigitalQueueMs.load(), queueMs);
+		nidaq->totalDigitalQueueMs += queueMs * numPendingChanges;
+		nidaq->numDigitalChanges += numPendingChanges;
+
+		numPendingChanges = 0;
+		blockEnded = false;
+	};
+
+	NIDAQmx::DigitalCommand command;
+
+	while (!threadShouldExit())
+	{
+		const double windowMs = nidaq->getDigitalCoalescingWindow();
+		const double holdMs = blockEnded ? windowMs : windowMs + maxBlockWaitMs;
+		const double pendingMs = numPendingChanges > 0 ? 1000.0 * Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - firstQueuedTicks) : 0.0;
+
+		if (numPendingChanges > 0 && pendingMs >= holdMs)
+		{
+			writePendingChanges();
+			continue;
+		}
+
+		if (!nidaq->digitalCommands.wait_for_command(numPendingChanges > 0 ? jmax(1, int(std::ceil(holdMs - pendingMs))) : 100))
+			continue;
+
+		while (nidaq->digitalCommands.pop(command))
+		{
+			if (command.channelIdx < 0)
+			{
+				blockEnded = numPendingChanges > 0;
+				continue;
+			}
+
+			if (command.channelIdx >= nidaq->dout.size() || !nidaq->dout[command.channelIdx]->isEnabled())
+				continue;
+
+			const int port = nidaq->digitalLinePorts[command.channelIdx];
+			const int bit = nidaq->digitalLineBits[command.channelIdx];
+
+			// Lines beyond the write size can't be reached
+			if (port >= numPorts || nidaq->digitalPortTasks[port] == 0 || bit >= nidaq->digitalWriteSize)
+				continue;
+
+			const NIDAQ::uInt32 mask = NIDAQ::uInt32(1) << bit;
+			NIDAQ::uInt32& word = nidaq->digitalPortWords[port];
+
+			// A line that changes back before its first change is written would lose a pulse
+			if ((changedLines[port] & mask) && ((word & mask) != 0) != command.state)
+				writePendingChanges();
+
+			word = command.state ? word | mask : word & ~mask;
+			changedLines[port] |= mask;
+
+			if (numPendingChanges == 0)
+				firstQueuedTicks = command.queuedTicks;
+			numPendingChanges++;
+		}
+	}
+
+}
+
 NIDAQmx::NIDAQmx(NIDAQDevice* device_) 
 : Thread("NIDAQmx-" + String(device_->getName())), device(device_)
 {
@@ -122,6 +272,8 @@ NIDAQmx::NIDAQmx(NIDAQDevice* device_)
 
 	digitalWriteSize = device->digitalWriteSize;
 
+	digitalWriter = std::make_unique<DigitalOutputThread>(this);
+
 	// Pre-define reasonable sample rates
 	float sample_rates[NUM_SAMPLE_RATES] = {
 		1000.0f, 1250.0f, 1500.0f,
@@ -142,17 +294,28 @@ NIDAQmx::NIDAQmx(NIDAQDevice* device_)
 
 	sampleRates.clear();
 
-	int idx = 0;
-	while (sample_rates[idx] <= device->sampleRateRange.max && idx < NUM_SAMPLE_RATES)
-		sampleRates.add(sample_rates[idx++]);
+	// Presets for the editor; any rate in the device's range can be used
+	for (int idx = 0; idx < NUM_SAMPLE_RATES; idx++)
+		if (sample_rates[idx] >= device->sampleRateRange.min && sample_rates[idx] <= device->sampleRateRange.max)
+			sampleRates.add(sample_rates[idx]);
 
-	// Default to highest sample rate
-	sampleRateIndex = sampleRates.size() - 1;
+	// Default to highest preset sample rate
+	setSampleRate(sampleRates.size() > 0 ? sampleRates.getLast() : device->sampleRateRange.max);
 
 	// Default to largest voltage range
 	voltageRangeIndex = device->voltageRanges.size() - 1;
 
-	analogOutBuffer = std::make_unique<CircularBuffer<double>>(200000);
+}
+
+NIDAQmx::~NIDAQmx()
+{
+
+	// Switching devices replaces this object, possibly mid-acquisition; the driver's tasks
+	// (and the AO task's callback) must not outlive it
+	stopDigitalWriter();
+	stopThread(5000);
+	clearTasks();
+	unlockProcessMemory();
 
 }
 
@@ -245,15 +408,16 @@ void NIDAQmx::connect()
 
 				aout.add(new AnalogOutput(name, termCfgs));
 
-				if (device->numAOChannels++ <= numActiveAnalogOutputs)
-				{
-					aout.getLast()->setAvailable(true);
+				// By default each output follows the input channel with the same index
+				aout.getLast()->setRouting("ch" + String(aout.size()));
+
+				aout.getLast()->setAvailable(true);
+				if (device->numAOChannels < numActiveAnalogOutputs)
 					aout.getLast()->setEnabled(true);
-				}
 
-				LOGD("Adding analog output channel: ", name, " with terminal config: ", " (", termCfgs, ") enabled: ", aout.getLast()->isEnabled() ? "YES" : "NO");
+				device->numAOChannels++;
 
-				if (aout.size() == MAX_NUM_ANALOG_OUTPUTS) break;
+				LOGD("Adding analog output channel: ", name, " with terminal config: ", " (", termCfgs, ") enabled: ", aout.getLast()->isEnabled() ? "YES" : "NO");
 				
 			}
 		}
@@ -261,38 +425,54 @@ void NIDAQmx::connect()
 		NIDAQ::int32	error = 0;
 		char			errBuff[ERR_BUFF_SIZE] = { '\0' };
 
-		// Get ADC resolution for each voltage range (throwing error as is)
-		NIDAQ::TaskHandle adcResolutionQuery;
-
-		NIDAQ::DAQmxCreateTask("ADCResolutionQuery", &adcResolutionQuery);
+		// Get ADC resolution and DAC scaling for each voltage range (throwing error as is)
+		NIDAQ::TaskHandle adcResolutionQuery = 0;
 
 		SettingsRange vRange;
 
-		for (int i = 0; i < device->voltageRanges.size(); i++)
+		for (int i = 0; i < device->voltageRanges.size() && aout.size() > 0; i++)
 		{
 			vRange = device->voltageRanges[i];
 
-			DAQmxErrChk(NIDAQ::DAQmxCreateAOVoltageChan(
-				adcResolutionQuery,				//task handle
-				STR2CHR(aout[i]->getName()),	//NIDAQ physical channel name (e.g. dev1/ai1)
-				"",								//user-defined channel name (optional)
-				//aout[i]->getSourceType(),		//input terminal configuration
-				vRange.min,						//min input voltage
-				vRange.max,						//max input voltage
-				DAQmx_Val_Volts,				//voltage units
-				NULL));
+			DAQmxErrChk(NIDAQ::DAQmxCreateTask("ADCResolutionQuery", &adcResolutionQuery));
+
+			for (auto output : aout)
+			{
+				DAQmxErrChk(NIDAQ::DAQmxCreateAOVoltageChan(
+					adcResolutionQuery,				//task handle
+					STR2CHR(output->getName()),		//NIDAQ physical channel name (e.g. dev1/ao1)
+					"",								//user-defined channel name (optional)
+					vRange.min,						//min output voltage
+					vRange.max,						//max output voltage
+					DAQmx_Val_Volts,				//voltage units
+					NULL));
+			}
 
 			NIDAQ::float64 adcResolution;
-			DAQmxErrChk(NIDAQ::DAQmxGetAOResolution(adcResolutionQuery, STR2CHR(aout[i]->getName()), &adcResolution));
+			DAQmxErrChk(NIDAQ::DAQmxGetAOResolution(adcResolutionQuery, STR2CHR(aout[0]->getName()), &adcResolution));
 
 			//TODO: DAQmxGetAOResolutionUnits/ DAQmxSetAOResolutionUnits
 
 			device->adcResolutions.add(adcResolution);
 
-		}
+			// Calibrated per channel; AO scaling is linear (intercept, slope). Devices
+			// without it can still output volts, so a failure here is not an error.
+			for (auto output : aout)
+			{
+				NIDAQ::float64 coeffs[4] = { 0 };
+				if (DAQmxFailed(NIDAQ::DAQmxGetAODevScalingCoeff(adcResolutionQuery, STR2CHR(output->getName()), coeffs, 4)))
+					output->addDACScaling(DACScaling());
+				else
+					output->addDACScaling(DACScaling(coeffs[0], coeffs[1]));
+
+				LOGD(output->getName(), " DAC scaling at ", vRange.min, " to ", vRange.max, " V: ", coeffs[0], " + ", coeffs[1], " * V");
+			}
+
+			NIDAQ::DAQmxStopTask(adcResolutionQuery);
+			NIDAQ::DAQmxClearTask(adcResolutionQuery);
+			adcResolutionQuery = 0;
 
-		NIDAQ::DAQmxStopTask(adcResolutionQuery);
-		NIDAQ::DAQmxClearTask(adcResolutionQuery);
+		}
 
 		// Get Digital Output Channels
 
@@ -309,6 +489,9 @@ void NIDAQmx::connect()
 		device->numDOChannels = 0;
 		dout.clear();
 
+		digitalLinePorts.clear();
+		digitalLineBits.clear();
+
 		for (int i = 0; i < channel_list.size(); i++)
 		{
 			StringArray channel_type;
@@ -320,6 +503,25 @@ void NIDAQmx::connect()
 				String lineName = fullName.fromFirstOccurrenceOf("/", false, false);
 				String portName = fullName.upToLastOccurrenceOf("/", false, false);
 
+				// A line's bit is its number (Dev1/port0/line3); the driver leaves out reserved lines,
+				// so the position within the port is only a fallback for names without one
+				const String lineNumber = lineName.fromLastOccurrenceOf("line", false, true);
+				int bit;
+
+				if (lineNumber.isNotEmpty() && lineNumber.length() <= 3 && lineNumber.containsOnly("0123456789"))
+					bit = lineNumber.getIntValue();
+				else if (!digitalLinePorts.isEmpty() && device->digitalPortNames[digitalLinePorts.getLast()] == portName.toStdString())
+					bit = digitalLineBits.getLast() + 1;
+				else
+					bit = 0;
+
+				// Port words are 32 bits wide; a line beyond them could never be written
+				if (bit >= 32)
+				{
+					LOGE("Skipping digital output line ", fullName, ": bit ", bit, " is outside a 32-bit port");
+					continue;
+				}
+
 				// Add port to list of ports
 				if (!device->digitalPortNames.contains(portName.toRawUTF8()))
 				{
@@ -332,6 +534,9 @@ void NIDAQmx::connect()
 
 				dout.add(new OutputChannel(fullName));
 
+				digitalLineBits.add(bit);
+				digitalLinePorts.add(device->digitalPortNames.indexOf(portName.toRawUTF8()));
+
 				dout.getLast()->setAvailable(true);
 				if (device->numDOChannels < numActiveDigitalOutputs)
 					dout.getLast()->setEnabled(true);
@@ -341,9 +546,12 @@ void NIDAQmx::connect()
 			}
 		}
 
-		device->sampleRateRange = SettingsRange(aoProps.maxRate, aoProps.maxRate);
+		device->sampleRateRange = SettingsRange(aoProps.minRate, aoProps.maxRate);
 
-		analogOutBuffer.reset();
+		device->supportsSinglePointOutput = false;
+		for (int i = 0; i < sizeof(aoProps.sampModes) / sizeof(NIDAQ::int32); i++)
+			if (aoProps.sampModes[i] == DAQmx_Val_HWTimedSinglePoint)
+				device->supportsSinglePointOutput = true;
 
 Error:
 
@@ -371,38 +579,124 @@ void NIDAQmx::startTasks()
 
 	StringArray port_list;
 
+	stopDigitalWriter();
+
 	clearTasks();
 
+	// Nothing is buffered for the analog outputs unless the AO task comes up
+	streamPaths.clear();
+	analogOutBuffer.reset();
+	outputEvents.reset();
+
+	// All enabled analog outputs share one task, in aout order
+	String analogChannelList;
+	analogOutputIndices.clear();
+
+	for (int i = 0; i < aout.size(); i++)
+	{
+		if (aout[i]->isEnabled())
+		{
+			analogChannelList += (analogChannelList.isEmpty() ? "" : ", ") + aout[i]->getName();
+			analogOutputIndices.add(i);
+		}
+	}
+
+	// Outputs whose source stream isn't in the signal chain are held at zero. If that is all of
+	// them, nothing would ever be buffered and the writer would pad every chunk, so leave them off
+	bool followsAnyStream = false;
+	for (int index : analogOutputIndices)
+		if (aout[index]->getSourceStream() < inputStreamSampleRates.size())
+			followsAnyStream = true;
+
+	if (analogOutputIndices.size() > 0 && !followsAnyStream)
+	{
+		LOGE("None of the enabled analog outputs follows a data stream in the signal chain; not starting the analog output task");
+		analogOutputIndices.clear();
+		analogChannelList.clear();
+	}
+
     NIDAQ::int32 error = 0;
     char errBuff[2048] = { '\0' };
 
     NIDAQ::int32 activeEdge = DAQmx_Val_Rising;
    	NIDAQ::int32 sampleMode = DAQmx_Val_ContSamps;
 
-    // Create an analog output task
-    if (device->isUSBDevice)
-		DAQmxErrChk(NIDAQ::DAQmxCreateTask("AOTask_USB", &taskHandleAO));
-	else
-		DAQmxErrChk(NIDAQ::DAQmxCreateTask("AOTask_PXI", &taskHandleAO));
-
-    // Create an analog output channel //TODO: Handle more than one channel
-	DAQmxErrChk(NIDAQ::DAQmxCreateAOVoltageChan(
-		taskHandleAO,
-		STR2CHR(device->getName() + "/ao0"), 
-		"", -10.0, 10.0,
-		DAQmx_Val_Volts,
-		nullptr)
-	);
-
-    // Configure the sample clock timing for the analog task
-    DAQmxErrChk(NIDAQ::DAQmxCfgSampClkTiming(
-		taskHandleAO,
-		"", 
-		getSampleRate(),
-		activeEdge, 
-		sampleMode, 
-		samplesPerChannel)
-	);
+	if (outputMode == SINGLE_POINT_OUTPUT && !device->supportsSinglePointOutput)
+	{
+		LOGE("Hardware-timed single point output isn't supported by this device; using standard output");
+		outputMode = STANDARD_OUTPUT;
+	}
+
+	// One sample per channel per clock tick, with no buffer in between
+	NIDAQ::int32 analogSampleMode = outputMode == SINGLE_POINT_OUTPUT ? DAQmx_Val_HWTimedSinglePoint : sampleMode;
+
+	if (analogOutputIndices.size() > 0)
+	{
+
+		// Create an analog output task
+		if (device->isUSBDevice)
+			DAQmxErrChk(NIDAQ::DAQmxCreateTask("AOTask_USB", &taskHandleAO));
+		else
+			DAQmxErrChk(NIDAQ::DAQmxCreateTask("AOTask_PXI", &taskHandleAO));
+
+		LOGD("Adding analog output channels: ", analogChannelList);
+
+		// Create all analog output channels with one call
+		DAQmxErrChk(NIDAQ::DAQmxCreateAOVoltageChan(
+			taskHandleAO,
+			STR2CHR(analogChannelList),
+			"", getVoltageRange().min, getVoltageRange().max,
+			DAQmx_Val_Volts,
+			nullptr)
+		);
+
+		// Configure the sample clock timing for the analog task
+		coercedSampleRate = 0;
+		DAQmxErrChk(NIDAQ::DAQmxCfgSampClkTiming(
+			taskHandleAO,
+			"", 
+			sampleRate,
+			activeEdge, 
+			analogSampleMode, 
+			samplesPerChannel)
+		);
+
+		// The device can only divide its timebase down to certain rates
+		DAQmxErrChk(NIDAQ::DAQmxGetSampClkRate(taskHandleAO, &coercedSampleRate));
+
+		if (coercedSampleRate != sampleRate)
+			LOGC("Analog output sample rate coerced from ", sampleRate, " Hz to ", coercedSampleRate, " Hz");
+
+		DAQmxErrChk(configureOutputMode());
+
+		// The prime and the first chunk after it must both fit in the host buffer
+		if (outputMode != SINGLE_POINT_OUTPUT && hostBufferFrames < NIDAQ::uInt32(getPrimeFrames() + samplesPerChannel))
+		{
+			DAQmxErrChk(NIDAQ::DAQmxCfgOutputBuffer(taskHandleAO, NIDAQ::uInt32(getPrimeFrames() + 2 * samplesPerChannel)));
+			NIDAQ::DAQmxGetBufOutputBufSize(taskHandleAO, &hostBufferFrames);
+		}
+
+	}
+
+	// Buffer sizes and resampling ratios use the coerced rate
+	prepareAnalogStreams();
+
+	worstCaseOutputLatencyMs = 0;
+
+	if (analogOutBuffer != nullptr)
+	{
+		// In single-point mode the buffer is emptied on every tick
+		NIDAQ::uInt64 bufferedFrames = analogOutBuffer->get_capacity() + hostBufferFrames + onboardBufferFrames;
+		if (outputMode == SINGLE_POINT_OUTPUT)
+			bufferedFrames = 1;
+
+		worstCaseOutputLatencyMs = 1000.0 * bufferedFrames / getSampleRate();
+
+		// Even when the device only asks for data once its FIFO is empty, one transfer can fill it again
+		LOGC("Analog output latency: up to ", worstCaseOutputLatencyMs, " ms (",
+			analogOutBuffer->get_capacity(), " buffered + ", hostBufferFrames, " host + ", onboardBufferFrames,
+			" onboard frames, ", getTransferConditionName(transferCondition), "), written ", samplesPerChannel, " frames at a time");
+	}
 
 	char ports[2048];
 	NIDAQ::DAQmxGetDevDOPorts(STR2CHR(device->getName()), &ports[0], sizeof(ports));
@@ -413,11 +707,19 @@ void NIDAQmx::startTasks()
 	for (auto& port : port_list)
 	{
 
-		if (port.length() && (portIdx*PORT_SIZE < dout.size()) && device->digitalPortStates[portIdx])
+		if (port.length() && digitalLinePorts.contains(portIdx) && device->digitalPortStates[portIdx])
 		{
 
 			LOGD("Adding digital output task on port ", portIdx, " (", port, ")");
 
+			int highestBit = 0;
+			for (int line = 0; line < digitalLinePorts.size(); line++)
+				if (digitalLinePorts[line] == portIdx)
+					highestBit = jmax(highestBit, digitalLineBits[line]);
+
+			if (highestBit >= digitalWriteSize)
+				LOGE("Port ", portIdx, " has lines up to line ", highestBit, "; only lines 0-", digitalWriteSize - 1, " are written");
+
 			NIDAQ::TaskHandle taskHandleDO = 0;
 
 			//Create a digital input task using device serial number to gurantee unique task name per device
@@ -440,68 +742,107 @@ void NIDAQmx::startTasks()
 			if (portIdx == 0)
 			{
 
-				// Configure sample clock timing
-				if (sendsSynchronizedEvents())
+				// Configure sample clock timing: one digital sample per analog sample, written by the writer thread
+				if (sendsSynchronizedEvents() && taskHandleAO != 0 && outputMode != SINGLE_POINT_OUTPUT)
 				{
 					DAQmxErrChk(NIDAQ::DAQmxCfgSampClkTiming(
 						taskHandleDO,
-						"",
+						STR2CHR("/" + device->getName() + "/ao/SampleClock"),
 						getSampleRate(),
 						activeEdge,
 						sampleMode,
 						samplesPerChannel)
 					);
 					LOGC("Configured sample clk timing for: ", port);
+
+					// Buffered like the AO task, so both hold the same frames
+					if (outputMode != STANDARD_OUTPUT)
+						DAQmxErrChk(NIDAQ::DAQmxSetWriteRegenMode(taskHandleDO, DAQmx_Val_DoNotAllowRegen));
+
+					DAQmxErrChk(NIDAQ::DAQmxCfgOutputBuffer(taskHandleDO, hostBufferFrames));
+
+					clockedDOTask = taskHandleDO;
+					clockedPort = portIdx;
+					hasNextEvent = false;
+
+					outputEvents = std::make_unique<CircularBuffer<OutputEvent>>(4096);
+					outputEvents->set_overrun_policy(OverrunPolicy::DROP_NEWEST);
+				}
+				else if (sendsSynchronizedEvents())
+				{
+					LOGE("Synchronized digital output needs buffered analog output; writing events as they arrive");
 				}
 			}
 
 			taskHandlesDO.push_back(taskHandleDO);
 
+			// Software-timed ports, by port number
+			digitalPortTasks.resize(portIdx + 1, 0);
+			if (taskHandleDO != clockedDOTask)
+				digitalPortTasks[portIdx] = taskHandleDO;
+
 		}
 
 		if (port.length()) portIdx++;
 
 	}
 
-	// Start both analog and digital output tasks
-    DAQmxErrChk(NIDAQ::DAQmxStartTask(taskHandleAO));
-	for (auto& taskHandleDO : taskHandlesDO)
-		DAQmxErrChk(NIDAQ::DAQmxStartTask(taskHandlesDO[0]));
-
-Error:
+	// Every port starts low; each word is only touched by the thread that writes that port
+	digitalPortWords.assign(digitalPortTasks.size(), 0);
 
-	if (DAQmxFailed(error))
-		NIDAQ::DAQmxGetExtendedErrorInfo(errBuff, ERR_BUFF_SIZE);
+	// Software-timed digital output, for ports without a sample clock
+	if (std::any_of(digitalPortTasks.begin(), digitalPortTasks.end(), [](NIDAQ::TaskHandle task) { return task != 0; }))
+	{
+		DigitalCommand staleCommand;
+		while (digitalCommands.pop(staleCommand))
+			continue;
+
+		totalDigitalQueueMs = 0;
+		totalDigitalWriteMs = 0;
+		numDigitalWrites = 0;
+		numDigitalChanges = 0;
+		lastDigitalQueueMs = maxDigitalQueueMs = 0;
+		lastDigitalWriteMs = maxDigitalWriteMs = 0;
+
+		digitalWriter->startThread();
+	}
 
-	if (DAQmxFailed(error))
-		LOGE("DAQmx Error: ", errBuff);
-	fflush(stdout);
+	// With analog outputs, the writer thread starts every task once the AO task is primed
+	if (taskHandleAO != 0)
+	{
+		hasWriteEvents = false;
 
-	return;
+		// Before the thread starts, so the driver's buffers are covered; the writer locks its own stack
+		if (lockProcessMemory && !processMemoryLocked)
+		{
+			processMemoryLocked = lock_process_memory();
 
-}
+			if (processMemoryLocked)
+				LOGC("Locked process memory");
+			else
+				LOGE("Unable to lock process memory (needs RLIMIT_MEMLOCK / CAP_IPC_LOCK; not available on Windows)");
+		}
 
-void NIDAQmx::clearTasks()
-{
+		// One event per chunk that leaves the host buffer; devices without the event fall back to polling
+		if (eventDrivenWrites && outputMode != SINGLE_POINT_OUTPUT)
+		{
+			if (DAQmxFailed(NIDAQ::DAQmxRegisterEveryNSamplesEvent(taskHandleAO, DAQmx_Val_Transferred_From_Buffer,
+				NIDAQ::uInt32(samplesPerChannel), 0, &NIDAQmx::onSamplesTransferred, this)))
+				LOGE("Every N samples events aren't available for this task; polling the device instead");
+			else
+				hasWriteEvents = true;
+		}
 
-	NIDAQ::int32	error = 0;
-	char			errBuff[ERR_BUFF_SIZE] = { '\0' };
+		// Reserve the hardware now so starting takes as little time as possible
+		DAQmxErrChk(NIDAQ::DAQmxTaskControl(taskHandleAO, DAQmx_Val_Task_Commit));
+		for (auto& taskHandleDO : taskHandlesDO)
+			DAQmxErrChk(NIDAQ::DAQmxTaskControl(taskHandleDO, DAQmx_Val_Task_Commit));
 
-	if (taskHandleAO > 0)
-	{
-		NIDAQ::DAQmxStopTask(taskHandleAO);
-		NIDAQ::DAQmxClearTask(taskHandleAO);
-		taskHandleAO = 0;
+		startThread();
 	}
-
-	if (taskHandlesDO.size() > 0)
+	else
 	{
-		for (auto& taskHandle : taskHandlesDO)
-		{
-			NIDAQ::DAQmxStopTask(taskHandle);
-			NIDAQ::DAQmxClearTask(taskHandle);
-		}
-		taskHandlesDO.clear();
+		DAQmxErrChk(startOutputTasks());
 	}
 
 Error:
@@ -514,127 +855,1288 @@ Error:
 	fflush(stdout);
 
 	return;
+
 }
 
-void NIDAQmx::analogWrite(AudioBuffer<float>& buffer, int numSamples)
+void NIDAQmx::unlockProcessMemory()
 {
-	NIDAQ::int32 error = 0;
-    NIDAQ::int32 numSamplesWritten;
-    NIDAQ::float64 timeout = 10.0;
-    char errBuff[2048] = { '\0' };
-
-	const int numChannels = 1; //TODO: Support more than one channel
-	
-	HeapBlock<NIDAQ::float64> outputData(numChannels*numSamples);
-
-	for (int sample = 0; sample < numChannels*numSamples; ++sample)
+	if (processMemoryLocked)
 	{
-		float inSample = buffer.getReadPointer(0)[sample];
-		outputData[sample] = static_cast<NIDAQ::float64>(inSample / 100.0f); //TODO: Scale to 10V
+		processMemoryLocked = false;
+
+		// Only the last instance unlocks the process, which also drops every buffer's own lock
+		if (unlock_process_memory() && !relock_memory_pages())
+			LOGE("Unable to lock analog output buffers in memory again");
 	}
+}
 
-	analogOutBuffer->write(outputData, numChannels*numSamples);
+void NIDAQmx::applyWriterScheduling()
+{
 
-	if (!isThreadRunning()) startThread();
+	writerIsRealtime = false;
+	writerIsPinned = false;
 
-Error:
+	if (writerPriority > 0)
+	{
+		writerIsRealtime = set_thread_realtime_priority(writerPriority);
 
-	if (DAQmxFailed(error))
-		NIDAQ::DAQmxGetExtendedErrorInfo(errBuff, ERR_BUFF_SIZE);
+		if (writerIsRealtime)
+			LOGC("Analog output writer running with real-time priority ", writerPriority);
+		else
+			LOGE("Unable to give the analog output writer real-time priority (needs RLIMIT_RTPRIO / CAP_SYS_NICE)");
+	}
 
-	if (DAQmxFailed(error))
-		LOGE("DAQmx Error: ", errBuff);
-	fflush(stdout);
+	if (writerCore >= 0)
+	{
+		writerIsPinned = set_thread_cpu_core(writerCore);
 
-	return;
+		if (writerIsPinned)
+			LOGC("Analog output writer pinned to CPU core ", writerCore);
+		else
+			LOGE("Unable to pin the analog output writer to CPU core ", writerCore);
+	}
+
+	// Threads started after lock_process_memory() get an unlocked stack
+	if (processMemoryLocked && !lock_thread_stack(WRITER_STACK_LOCK_BYTES))
+		LOGE("Unable to lock the analog output writer's stack in memory");
 
 }
 
-void NIDAQmx::addEvent(int64 sampleNumber, uint8 ttlLine, bool state)
+int NIDAQmx::getPrimeFrames()
 {
-	//TODO: Buffer events for synchronization
+	if (outputMode == SINGLE_POINT_OUTPUT)
+		return 0;
+
+	// Without regeneration the task can't start on an empty buffer
+	return jmax(int(samplesPerChannel), int(std::ceil(getSampleRate() * primeMs / 1000.0)));
 }
 
-void NIDAQmx::run() 
+NIDAQ::int32 NIDAQmx::startOutputTasks()
 {
 
 	NIDAQ::int32 error = 0;
-    char errBuff[2048] = { '\0' };
 
-	// Create arrays to hold the analog and digital data
-    HeapBlock<NIDAQ::float64> analogData(samplesPerChannel);
+	// Digital tasks first: a sample-clocked one waits for the AO sample clock
+	for (auto& taskHandleDO : taskHandlesDO)
+		DAQmxErrChk(NIDAQ::DAQmxStartTask(taskHandleDO));
 
-	int totalWrittenSamples = 0;
-	float timeout = 10.0;
+	if (taskHandleAO != 0)
+		DAQmxErrChk(NIDAQ::DAQmxStartTask(taskHandleAO));
 
-	NIDAQ::int32 writtenAnalogSamples = 0;
-	NIDAQ::int32 writtenDigitalSamples = 0;
+Error:
 
-	int numChannels = 1;
+	return error;
 
-	int loopCount = 0;
+}
 
-	while (!threadShouldExit())
+String NIDAQmx::getTransferConditionName(NIDAQ::int32 condition)
+{
+	switch (condition)
 	{
+	case DAQmx_Val_OnBrdMemEmpty:
+		return "refilled when the onboard buffer is empty";
+	case DAQmx_Val_OnBrdMemHalfFullOrLess:
+		return "refilled when the onboard buffer is half full or less";
+	case DAQmx_Val_OnBrdMemNotFull:
+		return "refilled whenever the onboard buffer is not full";
+	default:
+		return "unknown refill condition";
+	}
+}
 
-		analogOutBuffer->read(analogData, numChannels*samplesPerChannel);
+NIDAQ::int32 NIDAQmx::configureOutputMode()
+{
 
-		DAQmxErrChk(NIDAQ::DAQmxWriteAnalogF64(taskHandleAO, samplesPerChannel, 0, timeout, DAQmx_Val_GroupByChannel, analogData, &writtenAnalogSamples, NULL));
+	NIDAQ::int32 error = 0;
 
-		totalWrittenSamples += writtenAnalogSamples;
+	hostBufferFrames = 0;
+	onboardBufferFrames = 0;
+	transferCondition = 0;
 
-		loopCount++;
+	switch (outputMode)
+	{
+	case LOW_LATENCY_OUTPUT:
+		samplesPerChannel = jmax(NIDAQ::uInt64(8), NIDAQ::uInt64(std::ceil(getSampleRate() / 1000.0)));
+		break;
+	case HIGH_THROUGHPUT_OUTPUT:
+		samplesPerChannel = NIDAQ::uInt64(std::ceil(getSampleRate() / 20.0));
+		break;
+	case SINGLE_POINT_OUTPUT:
+		samplesPerChannel = 1;
+		break;
+	default:
+		samplesPerChannel = 200;
+		break;
+	}
 
+	if (outputMode == SINGLE_POINT_OUTPUT)
+	{
+		// A missed tick is counted by the writer rather than stopping the task
+		DAQmxErrChk(NIDAQ::DAQmxSetRealTimeConvLateErrorsToWarnings(taskHandleAO, true));
 	}
+	else if (outputMode != STANDARD_OUTPUT)
+	{
+		// Old samples are never replayed; the device stops instead (see run())
+		DAQmxErrChk(NIDAQ::DAQmxSetWriteRegenMode(taskHandleAO, DAQmx_Val_DoNotAllowRegen));
 
-	clearTasks();
+		// The host buffer holds a few chunks beyond the one being written
+		DAQmxErrChk(NIDAQ::DAQmxCfgOutputBuffer(taskHandleAO, NIDAQ::uInt32(samplesPerChannel * (outputMode == LOW_LATENCY_OUTPUT ? 4 : 8))));
+	}
 
-Error:
+	if (outputMode == LOW_LATENCY_OUTPUT)
+	{
+		// Not every device can shrink its FIFO or change when it asks for data; both are optional
+		if (DAQmxFailed(NIDAQ::DAQmxSetBufOutputOnbrdBufSize(taskHandleAO, NIDAQ::uInt32(samplesPerChannel * 2))))
+			LOGD("Onboard output buffer size is fixed on this device");
+
+		// Waiting for an empty FIFO keeps the fewest samples queued on the device
+		if (DAQmxFailed(NIDAQ::DAQmxSetAODataXferReqCond(taskHandleAO, "", DAQmx_Val_OnBrdMemEmpty))
+			&& DAQmxFailed(NIDAQ::DAQmxSetAODataXferReqCond(taskHandleAO, "", DAQmx_Val_OnBrdMemHalfFullOrLess)))
+			LOGD("Data transfer request condition is fixed on this device");
+	}
 
-	if (DAQmxFailed(error))
-		NIDAQ::DAQmxGetExtendedErrorInfo(errBuff, ERR_BUFF_SIZE);
+	// Single-point tasks have no output buffers
+	if (outputMode != SINGLE_POINT_OUTPUT)
+	{
+		NIDAQ::DAQmxGetBufOutputBufSize(taskHandleAO, &hostBufferFrames);
+		NIDAQ::DAQmxGetBufOutputOnbrdBufSize(taskHandleAO, &onboardBufferFrames);
+		NIDAQ::DAQmxGetAODataXferReqCond(taskHandleAO, "", &transferCondition);
+	}
 
-	if (DAQmxFailed(error))
-		LOGE("DAQmx Error: ", errBuff);
-	fflush(stdout);
+Error:
+
+	return error;
 
-	return;
-	
 }
 
-void NIDAQmx::digitalWrite(int channelIdx, bool state)
+void NIDAQmx::prepareAnalogStreams()
 {
 
-	NIDAQ::int32	error = 0;
-	char			errBuff[ERR_BUFF_SIZE] = { '\0' };
-	NIDAQ::int32 	write;
-	NIDAQ::uInt8	eventData[1] = {0};
+	analogRoutes.clear();
+	for (int index : analogOutputIndices)
+		analogRoutes.push_back(aout[index]->getRouting());
 
-	if (channelIdx >= dout.size())
-		return;
+	// One buffer channel per analog output in the AO task, in scan order
+	if (analogOutputIndices.size() > 0)
+		allocateAnalogBuffer(analogOutputIndices.size());
+	else
+		analogOutBuffer.reset();
 
-	if (dout[channelIdx]->isEnabled() && taskHandlesDO.size())
+	// Group the outputs by the data stream they follow, in stream order
+	streamPaths.clear();
+	silentAnalogChannels.clear();
+
+	for (int streamIndex = 0; streamIndex < inputStreamSampleRates.size(); streamIndex++)
 	{
+		StreamPath* path = nullptr;
 
-		uint8 mask = 1 << channelIdx;
-		if (state)
-			eventData[0] = eventCode | mask;
-		else
-			eventData[0] = eventCode & ~mask;
+		for (int channel = 0; channel < analogOutputIndices.size(); channel++)
+		{
+			if (aout[analogOutputIndices[channel]]->getSourceStream() != streamIndex)
+				continue;
+
+			if (path == nullptr)
+			{
+				path = streamPaths.add(new StreamPath());
+				path->streamIndex = streamIndex;
+			}
+
+			path->bufferChannels.add(channel);
+		}
+
+		if (path != nullptr && inputStreamSampleRates[streamIndex] != getSampleRate())
+		{
+			path->nominalSamplesPerFrame = inputStreamSampleRates[streamIndex] / getSampleRate();
+			path->samplesPerFrame = path->nominalSamplesPerFrame;
+			LOGC("Resampling data stream ", streamIndex, " from ", inputStreamSampleRates[streamIndex], " Hz to ", getSampleRate(), " Hz");
+		}
+	}
+
+	for (int channel = 0; channel < analogOutputIndices.size(); channel++)
+		if (aout[analogOutputIndices[channel]]->getSourceStream() >= inputStreamSampleRates.size())
+			silentAnalogChannels.add(channel);
+
+	// Each stream can get up to one analog output buffer's worth ahead of the others
+	for (auto path : streamPaths)
+	{
+		const int capacity = int(analogOutBuffer->get_capacity());
+		path->pending.setSize(path->bufferChannels.size(), capacity);
 
-		DAQmxErrChk(NIDAQ::DAQmxWriteDigitalU8(
-			taskHandlesDO[0],
-			1,
-			1,
-			10.0,
-			DAQmx_Val_GroupByChannel,
-			eventData,
-			&write,
-			nullptr
-		));
+		// Drift compensation needs a resampler even when the rates match
+		if (path->nominalSamplesPerFrame != 1.0 || driftCompensation)
+		{
+			const int mixedSize = int(std::ceil(capacity * jmax(1.0, path->samplesPerFrame)));
+			path->mixed.setSize(path->bufferChannels.size(), mixedSize);
+			path->resampler = std::make_unique<Resampler>(inputStreamSampleRates[path->streamIndex], getSampleRate(),
+				path->bufferChannels.size(), jmin(mixedSize, 4096));
+			path->mixedChannels.resize(path->bufferChannels.size());
+			path->pendingChannels.resize(path->bufferChannels.size());
+
+			LOGD("Stream ", path->streamIndex, " resampler: ", path->resampler->uses_exact_phases() ? "exact" : "interpolated",
+				" phases, ", 1000.0 * path->resampler->get_latency() / inputStreamSampleRates[path->streamIndex], " ms delay");
+		}
+	}
 
-		eventCode = eventData[0];
+	driftElapsedSeconds = 0;
+	filteredBufferFill = 0;
+	targetBufferFill = 0;
+	hasDriftTarget = false;
+	driftIntegral = 0;
+	clockDriftPpm = 0;
 
+}
+
+void NIDAQmx::allocateAnalogBuffer(int numChannels)
+{
+
+	// Never smaller than one write chunk; the buffer rounds up to a power of two
+	size_t numFrames = size_t(std::ceil(getSampleRate() * maxLatencyMs / 1000.0));
+	numFrames = jmax(numFrames, size_t(samplesPerChannel));
+
+	// Planar, so each channel of a GUI block is a single copy
+	analogOutBuffer = std::make_unique<AnalogBuffer>(numFrames, numChannels, BufferLayout::PLANAR);
+	analogOutBuffer->set_overrun_policy(overrunPolicy);
+	analogOutBuffer->set_underrun_policy(underrunPolicy);
+
+	// One tag per flushAnalogStreams() call; even small GUI blocks fit for the whole buffer
+	blockTags = std::make_unique<CircularBuffer<BlockTag>>(jmax(size_t(256), analogOutBuffer->get_capacity() / 32));
+
+	LOGC("Analog output buffer: ", analogOutBuffer->get_capacity(), " frames x ", numChannels, " channels (",
+		1000.0 * analogOutBuffer->get_capacity() / getSampleRate(), " ms at ", getSampleRate(), " Hz)");
+
+	if (lockBufferMemory)
+	{
+		if (analogOutBuffer->lock_memory())
+			LOGC("Locked analog output buffer in memory");
+		else
+			LOGE("Unable to lock analog output buffer in memory");
+	}
+
+}
+
+void NIDAQmx::clearTasks()
+{
+
+	NIDAQ::int32	error = 0;
+	char			errBuff[ERR_BUFF_SIZE] = { '\0' };
+
+	if (taskHandleAO > 0)
+	{
+		NIDAQ::DAQmxStopTask(taskHandleAO);
+
+		// The driver would otherwise hold on to this object's address
+		if (hasWriteEvents)
+			NIDAQ::DAQmxRegisterEveryNSamplesEvent(taskHandleAO, DAQmx_Val_Transferred_From_Buffer, NIDAQ::uInt32(samplesPerChannel), 0, NULL, NULL);
+		hasWriteEvents = false;
+
+		NIDAQ::DAQmxClearTask(taskHandleAO);
+		taskHandleAO = 0;
+	}
+
+	clockedDOTask = 0;
+	clockedPort = -1;
+
+	if (taskHandlesDO.size() > 0)
+	{
+		for (auto& taskHandle : taskHandlesDO)
+		{
+			NIDAQ::DAQmxStopTask(taskHandle);
+			NIDAQ::DAQmxClearTask(taskHandle);
+		}
+		taskHandlesDO.clear();
+	}
+
+	digitalPortTasks.clear();
+
+Error:
+
+	if (DAQmxFailed(error))
+		NIDAQ::DAQmxGetExtendedErrorInfo(errBuff, ERR_BUFF_SIZE);
+
+	if (DAQmxFailed(error))
+		LOGE("DAQmx Error: ", errBuff);
+	fflush(stdout);
+
+	return;
+}
+
+void NIDAQmx::setSampleRate(NIDAQ::float64 rate)
+{
+	sampleRate = jlimit(device->sampleRateRange.min, device->sampleRateRange.max, rate);
+	coercedSampleRate = 0;
+}
+
+NIDAQmx::StreamPath* NIDAQmx::getStreamPath(int streamIndex)
+{
+	for (auto path : streamPaths)
+		if (path->streamIndex == streamIndex)
+			return path;
+
+	return nullptr;
+}
+
+void NIDAQmx::discardPendingFrames(StreamPath* path, int numFrames)
+{
+	const int numRemaining = path->numPending - numFrames;
+
+	for (int i = 0; i < path->pending.getNumChannels(); i++)
+	{
+		float* samples = path->pending.getWritePointer(i);
+		memmove(samples, samples + numFrames, numRemaining * sizeof(float));
+	}
+
+	path->numPending = numRemaining;
+	path->nextSampleNumber += numFrames * path->samplesPerFrame;
+}
+
+void NIDAQmx::analogWrite(int streamIndex, AudioBuffer<float>& buffer, int firstChannel, int numChannels, int numSamples, int64 firstSampleNumber)
+{
+
+	StreamPath* path = getStreamPath(streamIndex);
+
+	if (path == nullptr || numSamples <= 0)
+		return;
+
+	const int capacity = path->pending.getNumSamples();
+	Resampler* resampler = path->resampler.get();
+
+	numSamples = jmin(numSamples, resampler != nullptr ? path->mixed.getNumSamples() : capacity);
+	const int numFrames = jmin(capacity, resampler != nullptr ? resampler->get_max_output(numSamples) : numSamples);
+
+	// A stream this far ahead of the others loses its oldest frames
+	const int overflow = path->numPending + numFrames - capacity;
+	if (overflow > 0)
+		discardPendingFrames(path, overflow);
+
+	path->blockFirstFrame = path->numPending;
+
+	if (path->numPending == 0)
+	{
+		// Resampled frames keep their own timeline, which runs on from the first block
+		if (resampler == nullptr || !path->hasStarted)
+			path->nextSampleNumber = double(firstSampleNumber);
+		path->arrivalTicks = Time::getHighResolutionTicks();
+	}
+
+	path->hasStarted = true;
+
+	for (int i = 0; i < path->bufferChannels.size(); i++)
+	{
+		float* outSamples = resampler != nullptr ? path->mixed.getWritePointer(i) : path->pending.getWritePointer(i, path->numPending);
+
+		// Only the input channels an output refers to are read
+		bool isEmpty = true;
+		for (auto& term : analogRoutes[path->bufferChannels[i]])
+		{
+			if (term.channel >= numChannels)
+				continue;
+
+			const float* inSamples = buffer.getReadPointer(firstChannel + term.channel);
+
+			if (isEmpty && term.weight == 1.0f)
+				FloatVectorOperations::copy(outSamples, inSamples, numSamples);
+			else if (isEmpty)
+				FloatVectorOperations::copyWithMultiply(outSamples, inSamples, term.weight, numSamples);
+			else if (term.weight == 1.0f)
+				FloatVectorOperations::add(outSamples, inSamples, numSamples);
+			else
+				FloatVectorOperations::addWithMultiply(outSamples, inSamples, term.weight, numSamples);
+
+			isEmpty = false;
+		}
+
+		if (isEmpty)
+			FloatVectorOperations::clear(outSamples, numSamples);
+	}
+
+	if (resampler != nullptr)
+	{
+		for (int i = 0; i < path->bufferChannels.size(); i++)
+		{
+			path->mixedChannels[i] = path->mixed.getReadPointer(i);
+			path->pendingChannels[i] = path->pending.getWritePointer(i, path->numPending);
+		}
+
+		path->numPending += resampler->process(path->mixedChannels.data(), numSamples,
+			path->pendingChannels.data(), capacity - path->numPending);
+	}
+	else
+	{
+		path->numPending += numSamples;
+	}
+
+}
+
+void NIDAQmx::flushAnalogStreams()
+{
+
+	if (analogOutBuffer == nullptr)
+		return;
+
+	// Only frames that every source stream has delivered can go out together
+	int numFrames = 0;
+	for (auto path : streamPaths)
+		numFrames = path == streamPaths[0] ? path->numPending : jmin(numFrames, path->numPending);
+
+	if (numFrames == 0)
+		return;
+
+	// The writer thread converts the buffered samples to volts
+	AnalogBuffer::Region region = analogOutBuffer->reserve(numFrames);
+
+	for (auto path : streamPaths)
+	{
+		for (int i = 0; i < path->bufferChannels.size(); i++)
+		{
+			const float* inSamples = path->pending.getReadPointer(i);
+
+			for (auto& span : { region.first, region.second })
+			{
+				FloatVectorOperations::copy(span.get_channel(path->bufferChannels[i]), inSamples, int(span.size));
+				inSamples += span.size;
+			}
+		}
+	}
+
+	// Outputs whose source stream isn't in the signal chain stay silent
+	for (int channel : silentAnalogChannels)
+		for (auto& span : { region.first, region.second })
+			FloatVectorOperations::clear(span.get_channel(channel), int(span.size));
+
+	analogOutBuffer->commit(region.size());
+
+	// Output frames are tagged with the sample numbers of the first source stream
+	StreamPath* reference = streamPaths[0];
+
+	if (region.size() > 0)
+	{
+		BlockTag tag;
+		tag.sampleNumber = reference->nextSampleNumber;
+		tag.framePosition = region.position;
+		tag.numFrames = region.size();
+		tag.samplesPerFrame = reference->samplesPerFrame;
+		tag.arrivalTicks = reference->arrivalTicks;
+		blockTags->write(&tag, 1);
+	}
+
+	for (auto path : streamPaths)
+	{
+		discardPendingFrames(path, numFrames);
+		path->arrivalTicks = Time::getHighResolutionTicks();
+	}
+
+	if (driftCompensation)
+		updateDriftCompensation(numFrames);
+
+}
+
+void NIDAQmx::updateDriftCompensation(int numFrames)
+{
+
+	// Time constants are in seconds of output
+	const double fillTimeConstant = 1.0;	// smooths out the writer's chunk-sized steps
+	const double settlingTime = 5.0;		// lets the buffer fill reach its working level
+	const double proportionalGain = 0.1;	// per second
+	const double integralGain = 0.0025;		// per second squared; critically damped with the above
+	const double maxDrift = 1000e-6;		// far beyond any crystal tolerance
+
+	const double elapsed = numFrames / getSampleRate();
+	const double fill = double(analogOutBuffer->get_write_position() - analogOutBuffer->get_read_position());
+
+	if (driftElapsedSeconds == 0)
+		filteredBufferFill = fill;
+	else
+		filteredBufferFill += (fill - filteredBufferFill) * elapsed / (fillTimeConstant + elapsed);
+
+	driftElapsedSeconds += elapsed;
+
+	if (driftElapsedSeconds < settlingTime)
+		return;
+
+	if (!hasDriftTarget)
+	{
+		targetBufferFill = filteredBufferFill;
+		hasDriftTarget = true;
+		LOGD("Drift compensation holding the analog output buffer at ", 1000.0 * targetBufferFill / getSampleRate(), " ms");
+	}
+
+	// A filling buffer means the source clock runs fast: produce fewer frames per source sample
+	const double error = (filteredBufferFill - targetBufferFill) / getSampleRate();
+
+	driftIntegral = jlimit(-maxDrift / integralGain, maxDrift / integralGain, driftIntegral + error * elapsed);
+
+	const double drift = integralGain * driftIntegral;
+	const double adjust = 1.0 - jlimit(-maxDrift, maxDrift, proportionalGain * error + drift);
+
+	for (auto path : streamPaths)
+	{
+		if (path->resampler == nullptr)
+			continue;
+
+		path->resampler->set_ratio_adjust(adjust);
+		path->samplesPerFrame = path->nominalSamplesPerFrame / adjust;
+	}
+
+	clockDriftPpm = drift * 1e6;
+
+}
+
+void NIDAQmx::addEvent(int streamIndex, int64 sampleNumber, int64 firstSampleNumber, uint8 ttlLine, bool state)
+{
+
+	if (outputEvents == nullptr || streamPaths.size() == 0)
+	{
+		digitalWrite(ttlLine, state);
+		return;
+	}
+
+	if (ttlLine >= dout.size() || !dout[ttlLine]->isEnabled())
+		return;
+
+	// Only the clocked port's lines are synchronized; the others are written as they arrive
+	if (digitalLinePorts[ttlLine] != clockedPort)
+	{
+		digitalWrite(ttlLine, state);
+		return;
+	}
+
+	// Pending frames, which flushAnalogStreams() is about to buffer from the write position on
+	double frame;
+	StreamPath* path = getStreamPath(streamIndex);
+
+	if (path != nullptr && path->hasStarted)
+	{
+		frame = (sampleNumber - path->nextSampleNumber) / path->samplesPerFrame;
+	}
+	else
+	{
+		// A stream without analog outputs lines up with the start of the first stream's block
+		const double streamRate = streamIndex < inputStreamSampleRates.size() ? inputStreamSampleRates[streamIndex] : getSampleRate();
+		frame = streamPaths[0]->blockFirstFrame + (sampleNumber - firstSampleNumber) * getSampleRate() / streamRate;
+	}
+
+	OutputEvent event;
+	event.sampleNumber = sampleNumber;
+	event.framePosition = analogOutBuffer->get_write_position() + uint64(jmax(0.0, std::floor(frame + 0.5)));
+	event.ttlLine = ttlLine;
+	event.state = state;
+
+	if (outputEvents->write(&event, 1) == 0)
+		LOGE("Synchronized digital output queue is full; dropped an event");
+
+}
+
+bool NIDAQmx::peekOutputEvent()
+{
+	if (!hasNextEvent)
+	{
+		CircularBuffer<OutputEvent>::Region region = outputEvents->peek(1);
+		if (region.size() == 0)
+			return false;
+		nextEvent = region.first.data[0];
+		hasNextEvent = outputEvents->release(1);
+	}
+
+	return hasNextEvent;
+}
+
+void NIDAQmx::fillDigitalChunk(uint64 position, int numSourceFrames, NIDAQ::uInt32* data, int numFrames)
+{
+
+	int frame = 0;
+
+	while (frame < numFrames)
+	{
+		int end = numFrames;
+
+		// Events are in order; late ones take effect on the first frame still to be written
+		while (frame < numSourceFrames && peekOutputEvent())
+		{
+			if (nextEvent.framePosition > position + frame)
+			{
+				end = int(jmin(position + numSourceFrames, nextEvent.framePosition) - position);
+				break;
+			}
+
+			const NIDAQ::uInt32 mask = NIDAQ::uInt32(1) << digitalLineBits[nextEvent.ttlLine];
+
+			if (nextEvent.state)
+				digitalPortWords[clockedPort] |= mask;
+			else
+				digitalPortWords[clockedPort] &= ~mask;
+
+			hasNextEvent = false;
+		}
+
+		std::fill(data + frame, data + end, digitalPortWords[clockedPort]);
+		frame = end;
+	}
+
+}
+
+void NIDAQmx::run() 
+{
+
+	NIDAQ::int32 error = 0;
+    char errBuff[2048] = { '\0' };
+
+	applyWriterScheduling();
+
+	int numChannels = analogOutBuffer->get_num_channels();
+
+	// Frames per channel in each write; fixed by the output mode unless chunking is adaptive
+	int writeFrames = int(samplesPerChannel);
+	int maxWriteFrames = writeFrames;
+
+	const int primeFrames = getPrimeFrames();
+
+	if (adaptiveChunking)
+	{
+		// Anywhere from 0.5 ms to 100 ms (or half the analog output buffer) per write
+		minChunkFrames = jmax(8, int(getSampleRate() / 2000.0));
+		maxChunkFrames = jmax(writeFrames, jmin(int(analogOutBuffer->get_capacity() / 2), int(getSampleRate() / 10.0)));
+		maxWriteFrames = maxChunkFrames;
+
+		backlogTargetFrames = 2.0 * writeFrames;
+		lastUnderflowTime = lastTargetChangeTime = Time::getMillisecondCounter();
+		lastDeviceUnderflows = 0;
+		wasBacklogLow = false;
+	}
+
+	// Event-driven writes top the device's queue back up to the prime, at least two chunks
+	const int eventTargetFrames = jmax(primeFrames, 2 * writeFrames);
+
+	if (hasWriteEvents)
+	{
+		if (adaptiveChunking)
+			LOGC("Adaptive chunk size isn't used with event-driven writes");
+
+		adaptiveChunking = false;
+		maxWriteFrames = eventTargetFrames;
+	}
+
+	writeChunkFrames = writeFrames;
+	deviceBacklogTarget = adaptiveChunking ? uint32(backlogTargetFrames) : hasWriteEvents ? uint32(eventTargetFrames) : 0;
+	numBacklogUnderruns = 0;
+	numWriteEvents = 0;
+
+	// The prime is converted and written in one go
+	const int maxConvertFrames = jmax(maxWriteFrames, primeFrames);
+
+	// Volts are computed here rather than on the audio thread, one chunk at a time
+	HeapBlock<NIDAQ::float64> analogData(numChannels*maxConvertFrames);
+
+	// Used when the underrun policy pads out a short chunk
+	HeapBlock<float> paddedData(numChannels*maxWriteFrames);
+
+	SettingsRange voltageRange = getVoltageRange();
+
+	// Raw codes skip the driver's scaling, but need the device's coefficients for every channel
+	bool writeRawCodes = analogDataFormat == RAW_I16;
+
+	// Per-channel scaling is fixed while the thread runs
+	Array<NIDAQ::float64> gains, offsets;
+	Array<DACScaling> dacScalings;
+
+	AnalogOutput unconfiguredOutput;
+
+	for (int channel = 0; channel < numChannels; channel++)
+	{
+		AnalogOutput* output = aout[analogOutputIndices[channel]];
+		if (output == nullptr)
+			output = &unconfiguredOutput;
+
+		gains.add(output->getGain());
+		offsets.add(output->getOffset());
+		dacScalings.add(output->getDACScaling(voltageRangeIndex));
+
+		if (!dacScalings.getLast().isValid())
+			writeRawCodes = false;
+	}
+
+	if (analogDataFormat == RAW_I16 && !writeRawCodes)
+		LOGE("No DAC scaling coefficients for this device and voltage range; writing volts instead");
+
+	HeapBlock<NIDAQ::int16> rawData(writeRawCodes ? numChannels*maxConvertFrames : 0);
+
+	// One port word per frame for the sample-clocked digital output task
+	HeapBlock<NIDAQ::uInt32> digitalData(clockedDOTask != 0 ? maxConvertFrames : 0);
+
+	// Converts part of one channel of the chunk, offset frames in
+	auto convertChunk = [&](int channel, const float* source, size_t offset, size_t numSamples)
+	{
+		uint64 clipped;
+		size_t index = channel * writeFrames + offset;
+
+		if (writeRawCodes)
+			clipped = convert_to_dac_codes(source, rawData + index, numSamples, gains[channel], offsets[channel],
+				voltageRange.min, voltageRange.max, dacScalings[channel].offset, dacScalings[channel].slope);
+		else
+			clipped = convert_to_volts(source, analogData + index, numSamples, gains[channel], offsets[channel],
+				voltageRange.min, voltageRange.max);
+
+		if (clipped > 0)
+			numClippedSamples += clipped;
+	};
+
+	NIDAQ::uInt64 deviceFramesWritten = 0;	// since the AO task was (re)started
+	float timeout = 10.0;
+
+	NIDAQ::int32 writtenAnalogSamples = 0;
+	NIDAQ::int32 writtenDigitalSamples = 0;
+
+	// Waiting policies wake up periodically so the thread can exit while starved;
+	// padding policies give up after one chunk's worth of time
+	int readTimeoutMs = 100;
+	if (analogOutBuffer->get_underrun_policy() != UnderrunPolicy::WAIT)
+		readTimeoutMs = jmax(1, int(1000.0 * samplesPerChannel / getSampleRate()));
+
+	// Event-driven writes only ever take what is already there
+	if (hasWriteEvents)
+		readTimeoutMs = 0;
+
+	analogOutBuffer->reset_counters();
+
+	hasCurrentTag = false;
+	hasNextTag = false;
+	maxBufferLatencyMs = 0;
+	totalBufferLatencyMs = 0;
+	numLatencyMeasurements = 0;
+	lastWrittenSampleNumber = -1;
+	numClippedSamples = 0;
+	numDeviceUnderflows = 0;
+
+	uint64 lastOverruns = 0;
+	uint64 lastUnderruns = 0;
+	uint32 lastReportTime = Time::getMillisecondCounter();
+
+	numLateSamples = 0;
+
+	HeapBlock<float> latestFrame(numChannels, true);
+	HeapBlock<float> newestFrame(numChannels, true);
+	NIDAQ::bool32 isLate = false;
+
+	// Fill the AO task's buffer before it starts, so the output latency is the same from the first sample
+	if (primeFrames > 0)
+	{
+		HeapBlock<float> primeData(numChannels * primeFrames, true);
+
+		uint64 primePosition = analogOutBuffer->get_read_position();
+		int primeSourceFrames = 0;
+
+		if (primeSource == PRIME_WITH_SAMPLES)
+		{
+			// Give the signal chain a moment to deliver them
+			const uint32 deadline = Time::getMillisecondCounter() + 2000;
+			while (!threadShouldExit() && !analogOutBuffer->wait_for_frames(primeFrames, 100) && Time::getMillisecondCounter() < deadline)
+				continue;
+
+			// Anything missing is made up with zeros in front. If the GUI overwrites (DROP_OLDEST)
+			// the frames while they are copied, the copy is torn: peek again, and prime with
+			// zeros if that keeps happening
+			for (int attempt = 0; attempt < 3; attempt++)
+			{
+				primeData.clear(numChannels * primeFrames);
+
+				AnalogBuffer::Region region = analogOutBuffer->peek(primeFrames);
+
+				size_t offset = primeFrames - region.size();
+				for (auto& span : { region.first, region.second })
+				{
+					for (int channel = 0; channel < numChannels; channel++)
+						FloatVectorOperations::copy(primeData + channel * primeFrames + offset, span.get_channel(channel), int(span.size));
+					offset += span.size;
+				}
+
+				if (analogOutBuffer->release(region.size()))
+				{
+					noteFramesWritten(region.position, int(region.size()));
+
+					primePosition = region.position;
+					primeSourceFrames = int(region.size());
+					break;
+				}
+			}
+
+			if (primeSourceFrames == 0)
+			{
+				primeData.clear(numChannels * primeFrames);
+				primePosition = analogOutBuffer->get_read_position();
+			}
+		}
+
+		// The digital outputs get the same frames, padding included
+		if (clockedDOTask != 0)
+		{
+			const int padding = primeFrames - primeSourceFrames;
+			fillDigitalChunk(primePosition, 0, digitalData, padding);
+			fillDigitalChunk(primePosition, primeSourceFrames, digitalData + padding, primeSourceFrames);
+
+			DAQmxErrChk(NIDAQ::DAQmxWriteDigitalU32(clockedDOTask, primeFrames, 0, timeout, DAQmx_Val_GroupByChannel, digitalData, &writtenDigitalSamples, NULL));
+		}
+
+		writeFrames = primeFrames;
+		for (int channel = 0; channel < numChannels; channel++)
+			convertChunk(channel, primeData + channel * primeFrames, 0, primeFrames);
+
+		if (writeRawCodes)
+			DAQmxErrChk(NIDAQ::DAQmxWriteBinaryI16(taskHandleAO, primeFrames, 0, timeout, DAQmx_Val_GroupByChannel, rawData, &writtenAnalogSamples, NULL));
+		else
+			DAQmxErrChk(NIDAQ::DAQmxWriteAnalogF64(taskHandleAO, primeFrames, 0, timeout, DAQmx_Val_GroupByChannel, analogData, &writtenAnalogSamples, NULL));
+
+		deviceFramesWritten += writtenAnalogSamples;
+		writeFrames = int(samplesPerChannel);
+
+		LOGD("Primed analog outputs with ", primeFrames, " frames (", 1000.0 * primeFrames / getSampleRate(), " ms)");
+	}
+
+	DAQmxErrChk(startOutputTasks());
+
+	// Single point: every tick gets the newest frame, or the previous one again if nothing new arrived
+	while (outputMode == SINGLE_POINT_OUTPUT && !threadShouldExit())
+	{
+		// Whatever else is queued is already out of date
+		AnalogBuffer::Region region = analogOutBuffer->peek(analogOutBuffer->get_capacity());
+
+		if (region.size() > 0)
+		{
+			const AnalogBuffer::Span& span = region.second.size > 0 ? region.second : region.first;
+
+			for (int channel = 0; channel < numChannels; channel++)
+				newestFrame[channel] = span.get_channel(channel)[(span.size - 1) * span.frame_stride];
+
+			// If the GUI overwrote (DROP_OLDEST) the frame while it was read, hold the previous one
+			if (analogOutBuffer->release(region.size()))
+			{
+				FloatVectorOperations::copy(latestFrame, newestFrame, numChannels);
+				noteFramesWritten(region.position + region.size() - 1, 1);
+			}
+			else
+			{
+				analogOutBuffer->note_underrun(1);
+			}
+		}
+
+		for (int channel = 0; channel < numChannels; channel++)
+			convertChunk(channel, latestFrame + channel, 0, 1);
+
+		if (writeRawCodes)
+			DAQmxErrChk(NIDAQ::DAQmxWriteBinaryI16(taskHandleAO, 1, 0, timeout, DAQmx_Val_GroupByChannel, rawData, &writtenAnalogSamples, NULL));
+		else
+			DAQmxErrChk(NIDAQ::DAQmxWriteAnalogF64(taskHandleAO, 1, 0, timeout, DAQmx_Val_GroupByChannel, analogData, &writtenAnalogSamples, NULL));
+
+		DAQmxErrChk(NIDAQ::DAQmxWaitForNextSampleClock(taskHandleAO, timeout, &isLate));
+
+		if (isLate)
+			numLateSamples++;
+	}
+
+	// Buffered output
+
+	while (!threadShouldExit())
+	{
+
+		// Report buffer problems as they happen, at most once per second
+		if (Time::getMillisecondCounter() - lastReportTime > 1000)
+		{
+			lastReportTime = Time::getMillisecondCounter();
+			if (analogOutBuffer->get_num_overruns() != lastOverruns || analogOutBuffer->get_num_underruns() != lastUnderruns)
+			{
+				lastOverruns = analogOutBuffer->get_num_overruns();
+				lastUnderruns = analogOutBuffer->get_num_underruns();
+				logBufferStatistics();
+			}
+		}
+
+		if (hasWriteEvents)
+		{
+			writeFrames = getNextEventWrite(deviceFramesWritten, eventTargetFrames);
+			if (writeFrames == 0)
+				continue;
+		}
+		else if (adaptiveChunking)
+		{
+			writeFrames = getNextWriteChunk(deviceFramesWritten);
+			if (writeFrames == 0)
+				continue;
+		}
+
+		uint64 readPosition = analogOutBuffer->get_read_position();
+		int numSourceFrames = writeFrames;
+
+		if (analogOutBuffer->wait_for_frames(writeFrames, readTimeoutMs))
+		{
+			// Convert straight out of the buffer's storage, then hand the frames back
+			AnalogBuffer::Region region = analogOutBuffer->peek(writeFrames);
+
+			size_t offset = 0;
+			for (auto& span : { region.first, region.second })
+			{
+				for (int channel = 0; channel < numChannels; channel++)
+					convertChunk(channel, span.get_channel(channel), offset, span.size);
+				offset += span.size;
+			}
+
+			// The GUI overwrote (DROP_OLDEST) part of the chunk while it was being converted
+			if (!analogOutBuffer->release(region.size()))
+			{
+				analogOutBuffer->note_underrun(region.size());
+				continue;
+			}
+
+			noteFramesWritten(region.position, region.size());
+		}
+		else if (analogOutBuffer->read(paddedData, writeFrames, 0))
+		{
+			for (int channel = 0; channel < numChannels; channel++)
+				convertChunk(channel, paddedData + channel * writeFrames, 0, writeFrames);
+
+			noteFramesWritten(readPosition, writeFrames);
+			numSourceFrames = int(analogOutBuffer->get_read_position() - readPosition);
+		}
+		else
+		{
+			continue;
+		}
+
+		// Digital samples go first, so the AO sample clock never finds the digital task empty
+		if (clockedDOTask != 0)
+		{
+			fillDigitalChunk(readPosition, numSourceFrames, digitalData, writeFrames);
+			DAQmxErrChk(NIDAQ::DAQmxWriteDigitalU32(clockedDOTask, writeFrames, 0, timeout, DAQmx_Val_GroupByChannel, digitalData, &writtenDigitalSamples, NULL));
+		}
+
+		if (writeRawCodes)
+			error = NIDAQ::DAQmxWriteBinaryI16(taskHandleAO, writeFrames, 0, timeout, DAQmx_Val_GroupByChannel, rawData, &writtenAnalogSamples, NULL);
+		else
+			error = NIDAQ::DAQmxWriteAnalogF64(taskHandleAO, writeFrames, 0, timeout, DAQmx_Val_GroupByChannel, analogData, &writtenAnalogSamples, NULL);
+
+		// Without regeneration the tasks stop when the device runs dry; restart them with this chunk
+		if (error == DAQmxErrorGenStoppedToPreventRegenOfOldSamples || error == DAQmxErrorOutputFIFOUnderflow2 || error == DAQmxErrorOutputFIFOUnderflow)
+		{
+			numDeviceUnderflows++;
+			LOGE("Analog output device ran out of samples (", numDeviceUnderflows.load(), " times); restarting");
+
+			// The digital task stalled with the AO sample clock. Unreserving drops what is left in
+			// both buffers, including the digital chunk written above, so each task gets this chunk
+			// exactly once and they start again in step
+			NIDAQ::DAQmxStopTask(taskHandleAO);
+			if (clockedDOTask != 0)
+				NIDAQ::DAQmxStopTask(clockedDOTask);
+
+			NIDAQ::DAQmxTaskControl(taskHandleAO, DAQmx_Val_Task_Unreserve);
+			DAQmxErrChk(NIDAQ::DAQmxTaskControl(taskHandleAO, DAQmx_Val_Task_Commit));
+
+			if (clockedDOTask != 0)
+			{
+				NIDAQ::DAQmxTaskControl(clockedDOTask, DAQmx_Val_Task_Unreserve);
+				DAQmxErrChk(NIDAQ::DAQmxTaskControl(clockedDOTask, DAQmx_Val_Task_Commit));
+			}
+
+			deviceFramesWritten = 0;
+
+			// Same order as the prime and startOutputTasks(): digital first, then analog
+			if (clockedDOTask != 0)
+				DAQmxErrChk(NIDAQ::DAQmxWriteDigitalU32(clockedDOTask, writeFrames, 0, timeout, DAQmx_Val_GroupByChannel, digitalData, &writtenDigitalSamples, NULL));
+
+			if (writeRawCodes)
+				DAQmxErrChk(NIDAQ::DAQmxWriteBinaryI16(taskHandleAO, writeFrames, 0, timeout, DAQmx_Val_GroupByChannel, rawData, &writtenAnalogSamples, NULL));
+			else
+				DAQmxErrChk(NIDAQ::DAQmxWriteAnalogF64(taskHandleAO, writeFrames, 0, timeout, DAQmx_Val_GroupByChannel, analogData, &writtenAnalogSamples, NULL));
+
+			if (clockedDOTask != 0)
+				DAQmxErrChk(NIDAQ::DAQmxStartTask(clockedDOTask));
+
+			DAQmxErrChk(NIDAQ::DAQmxStartTask(taskHandleAO));
+		}
+		else
+		{
+			DAQmxErrChk(error);
+		}
+
+		deviceFramesWritten += writtenAnalogSamples;
+
+	}
+
+Error:
+
+	if (DAQmxFailed(error))
+		NIDAQ::DAQmxGetExtendedErrorInfo(errBuff, ERR_BUFF_SIZE);
+
+	if (DAQmxFailed(error))
+		LOGE("DAQmx Error: ", errBuff);
+
+	logBufferStatistics();
+
+	// On an error too: a running AO task would keep calling onSamplesTransferred, and the
+	// digital writer must be done with the port tasks before they go
+	stopDigitalWriter();
+	clearTasks();
+
+	fflush(stdout);
+
+	return;
+	
+}
+
+int NIDAQmx::getNextWriteChunk(NIDAQ::uInt64 framesWritten)
+{
+
+	// Thresholds in ms; the window is how long the device must go without running low
+	// before the target is allowed to shrink again
+	const uint32 growHoldoffMs = 100;
+	const uint32 quietWindowMs = 5000;
+	const uint32 shrinkIntervalMs = 1000;
+
+	NIDAQ::uInt64 framesGenerated = 0;
+	NIDAQ::uInt32 spaceAvailable = 0;
+
+	// Devices without the properties keep the output mode's fixed chunk
+	if (DAQmxFailed(NIDAQ::DAQmxGetWriteTotalSampPerChanGenerated(taskHandleAO, &framesGenerated)) ||
+		DAQmxFailed(NIDAQ::DAQmxGetWriteSpaceAvail(taskHandleAO, &spaceAvailable)))
+		return int(samplesPerChannel);
+
+	const double backlog = framesWritten > framesGenerated ? double(framesWritten - framesGenerated) : 0.0;
+	const uint32 now = Time::getMillisecondCounter();
+
+	// The device came close to running dry (or did): queue more, quickly
+	const bool ranLow = framesWritten > 0 && backlog < minChunkFrames;
+	if (ranLow || numDeviceUnderflows.load() != lastDeviceUnderflows)
+	{
+		if (ranLow && !wasBacklogLow)
+			numBacklogUnderruns++;
+
+		lastDeviceUnderflows = numDeviceUnderflows.load();
+		lastUnderflowTime = now;
+
+		if (now - lastTargetChangeTime >= growHoldoffMs)
+		{
+			backlogTargetFrames = jmin(backlogTargetFrames * 2.0, 2.0 * maxChunkFrames);
+			lastTargetChangeTime = now;
+		}
+	}
+	// Nothing went wrong for a whole window: try a little less
+	else if (now - lastUnderflowTime >= quietWindowMs && now - lastTargetChangeTime >= shrinkIntervalMs)
+	{
+		backlogTargetFrames = jmax(backlogTargetFrames * 0.9, 2.0 * minChunkFrames);
+		lastTargetChangeTime = now;
+	}
+
+	wasBacklogLow = ranLow;
+
+	// Half the target per write keeps one chunk queued while the next is prepared
+	const int chunk = jlimit(minChunkFrames, maxChunkFrames, int(backlogTargetFrames / 2.0));
+
+	writeChunkFrames = uint32(chunk);
+	deviceBacklogTarget = uint32(backlogTargetFrames);
+
+	// Enough is queued (or the write would block): come back when it has drained
+	if (backlog + chunk > backlogTargetFrames || spaceAvailable < NIDAQ::uInt32(chunk))
+	{
+		const double excessFrames = jmax(backlog + chunk - backlogTargetFrames, double(chunk - int(spaceAvailable)));
+		wait(jlimit(1, 10, int(1000.0 * excessFrames / getSampleRate())));
+		return 0;
+	}
+
+	return chunk;
+
+}
+
+NIDAQ::int32 CVICALLBACK NIDAQmx::onSamplesTransferred(NIDAQ::TaskHandle taskHandle, NIDAQ::int32 eventType, NIDAQ::uInt32 numSamples, void* callbackData)
+{
+
+	// The driver's callback thread is shared by every task: hand the work to the writer
+	NIDAQmx* nidaq = static_cast<NIDAQmx*>(callbackData);
+
+	nidaq->numWriteEvents++;
+	nidaq->notify();
+
+	return 0;
+
+}
+
+int NIDAQmx::getNextEventWrite(NIDAQ::uInt64 framesWritten, int targetFrames)
+{
+
+	const int chunkFrames = int(samplesPerChannel);
+
+	NIDAQ::uInt64 framesGenerated = 0;
+	NIDAQ::uInt32 spaceAvailable = 0;
+
+	if (DAQmxFailed(NIDAQ::DAQmxGetWriteTotalSampPerChanGenerated(taskHandleAO, &framesGenerated)) ||
+		DAQmxFailed(NIDAQ::DAQmxGetWriteSpaceAvail(taskHandleAO, &spaceAvailable)))
+		spaceAvailable = 0;
+
+	const int backlog = framesWritten > framesGenerated ? int(framesWritten - framesGenerated) : 0;
+
+	// Never more than fits, so the write returns at once
+	const int needed = jmin(targetFrames - backlog, int(spaceAvailable));
+	const int available = int(analogOutBuffer->get_num_available());
+
+	writeChunkFrames = uint32(jmax(needed, 0));
+
+	if (needed > 0)
+	{
+		// Whole chunks where possible; the remainder goes out on a later event
+		if (available >= jmin(needed, chunkFrames))
+			return jmin(needed, available);
+
+		// About to run dry: let the underrun policy fill the gap
+		if (backlog < chunkFrames)
+			return jmin(needed, chunkFrames);
+	}
+
+	// Sleep until the driver has taken another chunk; the timeout covers missed events and frames
+	// arriving while the queue was short
+	wait(jmax(1, int(1000.0 * chunkFrames / getSampleRate())));
+
+	return 0;
+
+}
+
+void NIDAQmx::logBufferStatistics()
+{
+	if (analogOutBuffer == nullptr)
+		return;
+
+	LOGC("Analog output buffer: ",
+		analogOutBuffer->get_num_overruns(), " overruns (", analogOutBuffer->get_num_dropped_frames(), " frames dropped), ",
+		analogOutBuffer->get_num_underruns(), " underruns (", analogOutBuffer->get_num_padded_frames(), " frames padded), ",
+		numClippedSamples.load(), " samples clipped");
+
+	if (numLatencyMeasurements > 0)
+		LOGC("Analog output latency (GUI block to driver): last ", lastBufferLatencyMs.load(), " ms, mean ",
+			totalBufferLatencyMs / numLatencyMeasurements, " ms, max ", maxBufferLatencyMs, " ms");
+
+	if (numDeviceUnderflows > 0)
+		LOGC("Analog output device underflows: ", numDeviceUnderflows.load());
+
+	if (outputMode == SINGLE_POINT_OUTPUT)
+		LOGC("Single point output: ", numLateSamples.load(), " late sample clock ticks");
+
+	if (adaptiveChunking)
+		LOGC("Adaptive chunking: ", writeChunkFrames.load(), " frames per write, ", deviceBacklogTarget.load(),
+			" frames (", 1000.0 * deviceBacklogTarget.load() / getSampleRate(), " ms) queued on the device, ",
+			numBacklogUnderruns.load(), " near-underruns");
+
+	if (driftCompensation)
+		LOGC("Estimated clock drift (source vs. AO sample clock): ", clockDriftPpm.load(), " ppm");
+}
+
+void NIDAQmx::noteFramesWritten(uint64 framePosition, int numFrames)
+{
+
+	// Advance to the last block that starts at or before this chunk; blocks
+	// dropped by the output buffer are skipped over
+	while (true)
+	{
+		if (!hasNextTag)
+		{
+			CircularBuffer<BlockTag>::Region region = blockTags->peek(1);
+			if (region.size() == 0)
+				break;
+			nextTag = region.first.data[0];
+			hasNextTag = blockTags->release(1);
+		}
+
+		if (!hasNextTag || nextTag.framePosition > framePosition)
+			break;
+
+		currentTag = nextTag;
+		hasCurrentTag = true;
+		hasNextTag = false;
+	}
+
+	// Padding written while the buffer was empty has no source samples
+	if (!hasCurrentTag || numFrames <= 0 || framePosition >= currentTag.framePosition + currentTag.numFrames)
+		return;
+
+	lastWrittenSampleNumber = int64(std::floor(currentTag.sampleNumber + double(framePosition - currentTag.framePosition) * currentTag.samplesPerFrame + 0.5));
+
+	double latencyMs = 1000.0 * Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - currentTag.arrivalTicks);
+	lastBufferLatencyMs = latencyMs;
+	maxBufferLatencyMs = jmax(maxBufferLatencyMs, latencyMs);
+	totalBufferLatencyMs += latencyMs;
+	numLatencyMeasurements++;
+
+}
+
+void NIDAQmx::digitalWrite(int channelIdx, bool state)
+{
+
+	DigitalCommand command;
+	command.channelIdx = channelIdx;
+	command.state = state;
+	command.queuedTicks = Time::getHighResolutionTicks();
+
+	// A full queue drops the change; counted in logDigitalStatistics()
+	digitalCommands.push(command);
+
+	hasUnflushedDigitalWrites = true;
+
+}
+
+void NIDAQmx::flushDigitalWrites()
+{
+	if (!hasUnflushedDigitalWrites.exchange(false))
+		return;
+
+	// Marks the end of the block for the digital output thread
+	DigitalCommand marker;
+	marker.channelIdx = -1;
+	marker.queuedTicks = Time::getHighResolutionTicks();
+
+	digitalCommands.push(marker);
+}
+
+void NIDAQmx::stopDigitalWriter()
+{
+	if (!digitalWriter->isThreadRunning())
+		return;
+
+	digitalWriter->stopThread(1000);
+	logDigitalStatistics();
+}
+
+void NIDAQmx::logDigitalStatistics()
+{
+	if (numDigitalChanges == 0 && digitalCommands.get_num_dropped() == 0)
+		return;
+
+	LOGC("Digital output: ", numDigitalChanges, " changes in ", numDigitalWrites, " port writes, queued ",
+		numDigitalChanges > 0 ? totalDigitalQueueMs / numDigitalChanges : 0.0, " ms on average (max ", maxDigitalQueueMs.load(), " ms), written in ",
+		numDigitalWrites > 0 ? totalDigitalWriteMs / numDigitalWrites : 0.0, " ms on average (max ", maxDigitalWriteMs.load(), " ms), ",
+		digitalCommands.get_num_dropped(), " dropped");
+}
+
+void NIDAQmx::writeDigitalPort(int port)
+{
+
+	NIDAQ::int32	error = 0;
+	char			errBuff[ERR_BUFF_SIZE] = { '\0' };
+	NIDAQ::int32 	write;
+
+	// The whole port in one call, at the configured width
+	switch (digitalWriteSize)
+	{
+	case 32:
+	{
+		NIDAQ::uInt32 portData[1] = { digitalPortWords[port] };
+		DAQmxErrChk(NIDAQ::DAQmxWriteDigitalU32(digitalPortTasks[port], 1, 1, 10.0, DAQmx_Val_GroupByChannel, portData, &write, nullptr));
+		break;
+	}
+	case 16:
+	{
+		NIDAQ::uInt16 portData[1] = { NIDAQ::uInt16(digitalPortWords[port]) };
+		DAQmxErrChk(NIDAQ::DAQmxWriteDigitalU16(digitalPortTasks[port], 1, 1, 10.0, DAQmx_Val_GroupByChannel, portData, &write, nullptr));
+		break;
+	}
+	default:
+	{
+		NIDAQ::uInt8 portData[1] = { NIDAQ::uInt8(digitalPortWords[port]) };
+		DAQmxErrChk(NIDAQ::DAQmxWriteDigitalU8(digitalPortTasks[port], 1, 1, 10.0, DAQmx_Val_GroupByChannel, portData, &write, nullptr));
+		break;
+	}
 	}
 
 Error:
@@ -32,16 +32,21 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "nidaq-api/NIDAQmx.h"
 
 #include "CircularBuffer.h"
+#include "CommandQueue.h"
+#include "OutputKernels.h"
+#include "RealtimeThread.h"
+#include "Resampler.h"
 
 #define NUM_SAMPLE_RATES 18
 
 #define PORT_SIZE 8 //number of bits in a port
 #define DEFAULT_NUM_ANALOG_OUTPUTS 1
-#define MAX_NUM_ANALOG_OUTPUTS 1
 #define DEFAULT_NUM_DIGITAL_OUTPUTS 8
 
 #define ERR_BUFF_SIZE 2048
 
+#define WRITER_STACK_LOCK_BYTES (256 * 1024) //stack the writer pins when process memory is locked
+
 #define STR2CHR( jString ) ((jString).toUTF8())
 #define DAQmxErrChk(functionCall) if( DAQmxFailed(error=(functionCall)) ) goto Error; else
 
@@ -57,6 +62,26 @@ enum SOURCE_TYPE {
 	PSEUDO_DIFF
 };
 
+/* How analog output samples are handed to the driver */
+enum AO_DATA_FORMAT {
+	SCALED_F64 = 0,	// volts, scaled to DAC codes by DAQmx
+	RAW_I16			// DAC codes, scaled by us with the device's coefficients
+};
+
+/* Trade-off between output latency and CPU/driver load for the AO task */
+enum AO_OUTPUT_MODE {
+	STANDARD_OUTPUT = 0,	// 200-sample writes, driver default buffering
+	LOW_LATENCY_OUTPUT,		// 1 ms writes, minimal host and onboard buffers, no regeneration
+	HIGH_THROUGHPUT_OUTPUT,	// 50 ms writes, deep host buffer, no regeneration
+	SINGLE_POINT_OUTPUT		// hardware-timed single point: the newest frame on every sample clock tick
+};
+
+/* What the AO task's buffer holds before the task starts */
+enum PRIME_SOURCE {
+	PRIME_WITH_ZEROS = 0,	// GUI-zero (each output's offset)
+	PRIME_WITH_SAMPLES		// the first samples to arrive from the GUI
+};
+
 struct DeviceAOProperties
 {
     char physicalChans[256]; // Assuming max 256 characters
@@ -155,6 +180,21 @@ struct SettingsRange {
 		: min(min_), max(max_) {}
 };
 
+/* Volts to DAC code scaling of one analog output at one voltage range: code = offset + slope * volts */
+struct DACScaling {
+	NIDAQ::float64 offset, slope;
+	DACScaling() : offset(0), slope(0) {}
+	DACScaling(NIDAQ::float64 offset_, NIDAQ::float64 slope_)
+		: offset(offset_), slope(slope_) {}
+	bool isValid() const { return slope != 0; }
+};
+
+/* One input channel's contribution to an analog output */
+struct RoutingTerm {
+	int channel;	// input channel index in the processor's buffer
+	float weight;
+};
+
 class OutputChannel
 {
 public:
@@ -190,9 +230,41 @@ public:
 	SOURCE_TYPE getSourceType() { return sourceTypes[sourceTypeIndex]; }
 	void setNextSourceType() { sourceTypeIndex = (sourceTypeIndex + 1) % sourceTypes.size(); }
 
+	// Volts output per unit of input signal, and volts added after scaling
+	void setGain(NIDAQ::float64 gain_) { gain = gain_; }
+	NIDAQ::float64 getGain() { return gain; }
+
+	void setOffset(NIDAQ::float64 offset_) { offset = offset_; }
+	NIDAQ::float64 getOffset() { return offset; }
+
+	// Index of the data stream this output follows
+	void setSourceStream(int streamIndex) { sourceStream = streamIndex; }
+	int getSourceStream() { return sourceStream; }
+
+	// Weighted sum of input channels sent to this output, written with 1-based
+	// channel numbers within the source stream, e.g. "ch12 - ch13" or
+	// "0.5*ch1 + 0.5*ch2". Returns false (keeping the current routing) if the
+	// expression can't be parsed.
+	bool setRouting(String expression);
+	String getRoutingExpression() { return routingExpression; }
+	const std::vector<RoutingTerm>& getRouting() { return routing; }
+
+	// Device scaling coefficients, one per device voltage range
+	void addDACScaling(DACScaling scaling) { dacScalings.add(scaling); }
+	DACScaling getDACScaling(int rangeIndex) { return dacScalings[rangeIndex]; }
+
 private:
 	int sourceTypeIndex = 0;
 	Array<SOURCE_TYPE> sourceTypes;
+
+	NIDAQ::float64 gain = 0.01;
+	NIDAQ::float64 offset = 0.0;
+
+	Array<DACScaling> dacScalings;
+
+	int sourceStream = 0;
+	String routingExpression;
+	std::vector<RoutingTerm> routing;
 };
 
 class NIDAQDevice
@@ -220,6 +292,7 @@ public:
 	SettingsRange sampleRateRange;
 
 	bool isUSBDevice;
+	bool supportsSinglePointOutput = false;	// DAQmx_Val_HWTimedSinglePoint AO timing
 
 	Array<SettingsRange> voltageRanges;
 	Array<NIDAQ::float64> adcResolutions;
@@ -259,12 +332,24 @@ private:
 	int activeDeviceIndex;
 };
 
+/* Applies software-timed digital output changes queued by digitalWrite(), off the GUI's processing thread */
+class DigitalOutputThread : public Thread
+{
+public:
+	DigitalOutputThread(NIDAQmx* nidaq_);
+
+	void run() override;
+
+private:
+	NIDAQmx* nidaq;
+};
+
 class NIDAQmx : public Thread
 {
 public:
 
 	NIDAQmx(NIDAQDevice* device_);
-	~NIDAQmx() {};
+	~NIDAQmx();
 
 	/* Pointer to the active device */
 	NIDAQDevice* device;
@@ -279,8 +364,13 @@ public:
 	DeviceAOProperties NIDAQmx::getDeviceAOProperties(const char* device);
 
 	/* Analog configuration */
-	NIDAQ::float64 getSampleRate() { return sampleRates[sampleRateIndex]; };
-	void setSampleRate(int index) { sampleRateIndex = index; };
+	/* Rate the AO task runs at: the device's coerced rate once the task exists, otherwise the requested rate */
+	NIDAQ::float64 getSampleRate() { return coercedSampleRate > 0 ? coercedSampleRate : sampleRate; };
+	NIDAQ::float64 getRequestedSampleRate() { return sampleRate; };
+
+	/* Any rate within the device's AO range; clamped to it */
+	void setSampleRate(NIDAQ::float64 rate);
+	SettingsRange getSampleRateRange() { return device->sampleRateRange; };
 
 	SettingsRange getVoltageRange() { return device->voltageRanges[voltageRangeIndex]; };
 	void setVoltageRange(int index) { voltageRangeIndex = index; };
@@ -311,22 +401,154 @@ public:
 	void startTasks();
 	void clearTasks();
 
-	void analogWrite(AudioBuffer<float>& buffer, int numSamples);
+	/* Sample rate of each data stream reaching the processor, in order; used by startTasks() */
+	void setInputStreams(Array<float> sampleRates) { inputStreamSampleRates = sampleRates; };
+
+	/* Queues one stream's block (numChannels channels from firstChannel) for the outputs that follow it */
+	void analogWrite(int streamIndex, AudioBuffer<float>& buffer, int firstChannel, int numChannels, int numSamples, int64 firstSampleNumber);
+
+	/* Moves the frames every source stream has delivered into the analog output buffer; call after each block */
+	void flushAnalogStreams();
+
+	/* Queues a software-timed line change for the digital output thread; safe on any thread, never blocks */
 	void digitalWrite(int channelIdx, bool state);
 
+	/* Ends the current processing block: its software-timed changes are written together,
+	   one word per port. Call once per block, after the block's digitalWrite() calls. */
+	void flushDigitalWrites();
+
+	/* Blocks whose changes start within this window are merged into the same writes as well
+	   (ms, 0 for one write per block) */
+	void setDigitalCoalescingWindow(int ms) { digitalCoalescingMs = ms; };
+	int getDigitalCoalescingWindow() { return digitalCoalescingMs.load(); };
+
+	/* Stops the digital output thread; pending changes are dropped */
+	void stopDigitalWriter();
+
+	/* Time software-timed changes spent queued, and port writes in the driver, for the last one and at most (ms) */
+	double getLastDigitalQueueTime() { return lastDigitalQueueMs.load(); };
+	double getMaxDigitalQueueTime() { return maxDigitalQueueMs.load(); };
+	double getLastDigitalWriteTime() { return lastDigitalWriteMs.load(); };
+	double getMaxDigitalWriteTime() { return maxDigitalWriteMs.load(); };
+
+	/* Logs the timing of software-timed digital output changes */
+	void logDigitalStatistics();
+
 	void run() override;
 
-	void addEvent(int64 sampleNumber, uint8 ttlLine, bool state);
+	/* Schedules a TTL line change at the output frame of sampleNumber on the sample-clocked digital
+	   output port; firstSampleNumber is that of the event's block. Call between the block's
+	   analogWrite() and flushAnalogStreams(). Without synchronized output it is written at once. */
+	void addEvent(int streamIndex, int64 sampleNumber, int64 firstSampleNumber, uint8 ttlLine, bool state);
 
 	bool shouldSendSynchronizedEvents(bool sendSynchronizedEvents_) { sendSynchronizedEvents =  sendSynchronizedEvents_; };
 	bool sendsSynchronizedEvents() { return sendSynchronizedEvents; };
 
+	/* Analog output buffer behaviour when the GUI gets ahead of / falls behind the device */
+	void setOverrunPolicy(OverrunPolicy policy) { overrunPolicy = policy; };
+	OverrunPolicy getOverrunPolicy() { return overrunPolicy; };
+
+	void setUnderrunPolicy(UnderrunPolicy policy) { underrunPolicy = policy; };
+	UnderrunPolicy getUnderrunPolicy() { return underrunPolicy; };
+
+	/* Analog output buffer size, as the longest output latency it may hold (ms) */
+	void setMaxLatency(int maxLatencyMs_) { maxLatencyMs = maxLatencyMs_; };
+	int getMaxLatency() { return maxLatencyMs; };
+
+	/* Write volts (DAQmx scales them) or raw DAC codes (scaled by the plugin) */
+	void setAnalogDataFormat(AO_DATA_FORMAT format) { analogDataFormat = format; };
+	AO_DATA_FORMAT getAnalogDataFormat() { return analogDataFormat; };
+
+	/* Chunk size and device buffering of the AO task; applied by startTasks() */
+	void setOutputMode(AO_OUTPUT_MODE mode) { outputMode = mode; };
+	AO_OUTPUT_MODE getOutputMode() { return outputMode; };
+
+	/* Longest time a sample can spend between analogWrite() and the DAC with the current
+	   buffers (analog output buffer, host buffer and onboard FIFO), in ms; set by startTasks() */
+	double getWorstCaseOutputLatency() { return worstCaseOutputLatencyMs; };
+
+	/* Let the writer thread resize its chunks and the amount it keeps queued on the device,
+	   settling on the least latency that hasn't underrun recently */
+	void setAdaptiveChunking(bool adaptiveChunking_) { adaptiveChunking = adaptiveChunking_; };
+	bool getAdaptiveChunking() { return adaptiveChunking; };
+
+	/* Frames per channel in the writer's current chunk, and the number it aims to keep queued on the device */
+	uint32 getWriteChunkSize() { return writeChunkFrames.load(); };
+	uint32 getDeviceBacklogTarget() { return deviceBacklogTarget.load(); };
+
+	/* Have the driver wake the writer thread whenever a chunk has left the AO task's buffer,
+	   instead of polling it and blocking in writes; ignored in single-point mode */
+	void setEventDrivenWrites(bool eventDrivenWrites_) { eventDrivenWrites = eventDrivenWrites_; };
+	bool getEventDrivenWrites() { return eventDrivenWrites; };
+
+	/* Output queued on the device before the AO and DO tasks start together; the
+	   output latency is fixed from the first sample (ms, 0 for a single chunk) */
+	void setPrimeLength(int primeMs_) { primeMs = primeMs_; };
+	int getPrimeLength() { return primeMs; };
+
+	void setPrimeSource(PRIME_SOURCE source) { primeSource = source; };
+	PRIME_SOURCE getPrimeSource() { return primeSource; };
+
+	/* Single-point mode: sample clock ticks the writer thread missed */
+	uint64 getNumLateSamples() { return numLateSamples.load(); };
+
+	/* Every-N-samples events received from the AO task since the writer thread started */
+	uint64 getNumWriteEvents() { return numWriteEvents.load(); };
+
+	/* Times the device ran out of samples and the AO task had to be restarted */
+	uint64 getNumDeviceUnderflows() { return numDeviceUnderflows.load(); };
+
+	/* Trim each stream's resampling ratio so the analog output buffer fill, and with it
+	   the output latency, stays where it settled after the start of acquisition */
+	void setDriftCompensation(bool driftCompensation_) { driftCompensation = driftCompensation_; };
+	bool getDriftCompensation() { return driftCompensation; };
+
+	/* Estimated rate of the source clock relative to the AO sample clock, in ppm
+	   (positive when the source runs fast); 0 until drift compensation has settled */
+	double getClockDriftPpm() { return clockDriftPpm.load(); };
+
+	/* Writer thread scheduling, applied as it starts: real-time (SCHED_FIFO) priority, 0 for
+	   normal scheduling, and the CPU core it runs on, -1 for any */
+	void setWriterPriority(int writerPriority_) { writerPriority = writerPriority_; };
+	int getWriterPriority() { return writerPriority; };
+
+	void setWriterCore(int writerCore_) { writerCore = writerCore_; };
+	int getWriterCore() { return writerCore; };
+
+	/* Pin the process's current pages, and the writer's stack, in RAM while acquiring (mlockall) */
+	void setLockProcessMemory(bool lockProcessMemory_) { lockProcessMemory = lockProcessMemory_; };
+	bool getLockProcessMemory() { return lockProcessMemory; };
+
+	/* Whether each of the settings above actually took effect for the current acquisition */
+	bool isWriterRealtime() { return writerIsRealtime.load(); };
+	bool isWriterPinned() { return writerIsPinned.load(); };
+	bool isProcessMemoryLocked() { return processMemoryLocked.load(); };
+
+	/* Undoes setLockProcessMemory() once acquisition has stopped */
+	void unlockProcessMemory();
+
+	/* Pin the analog output buffer in RAM */
+	void setLockBufferMemory(bool lockBufferMemory_) { lockBufferMemory = lockBufferMemory_; };
+	bool getLockBufferMemory() { return lockBufferMemory; };
+
+	/* Logs overrun/underrun counts of the analog output buffer */
+	void logBufferStatistics();
+
+	/* Output samples clamped to the voltage range since the writer thread started */
+	uint64 getNumClippedSamples() { return numClippedSamples.load(); };
+
+	/* Source sample number of the first frame of the last chunk handed to the driver (-1 if unknown) */
+	int64 getLastWrittenSampleNumber() { return lastWrittenSampleNumber.load(); };
+
+	/* Time that frame spent between analogWrite() and the driver (ms) */
+	double getLastBufferLatency() { return lastBufferLatencyMs.load(); };
+
 	Array<NIDAQ::float64> sampleRates;
 
 	OwnedArray<AnalogOutput> 	aout;
 	OwnedArray<OutputChannel> 	dout;
 
-	NIDAQ::TaskHandle taskHandleAO;
+	NIDAQ::TaskHandle taskHandleAO = 0;
 	std::vector<NIDAQ::TaskHandle> taskHandlesDO;
 
 private:
@@ -335,9 +557,11 @@ private:
 	ScopedPointer<NIDAQmxDeviceManager> dm;
 
 	int deviceIndex = 0;
-	int sampleRateIndex = 0;
 	int voltageRangeIndex = 0;
 
+	NIDAQ::float64 sampleRate = 0;
+	NIDAQ::float64 coercedSampleRate = 0;	// read back from the AO task; 0 until it is configured
+
 	/* Assign a default port to be assigned as output */
 	int defaultOutputPort = 0;
 
@@ -349,26 +573,235 @@ private:
 	int numActiveAnalogOutputs = DEFAULT_NUM_ANALOG_OUTPUTS; //2
 	int numActiveDigitalOutputs = DEFAULT_NUM_DIGITAL_OUTPUTS; //8
 
-	NIDAQ::uInt8 eventCode;
-
 	NIDAQ::uInt64 samplesPerChannel = 200;
 
+	/* A TTL line change, placed on the analog output buffer's timeline */
 	struct OutputEvent
 	{
-		OutputEvent(int64 sampleNumber_, int ttlLine_, bool state_) :
-			sampleNumber(sampleNumber_),
-			ttlLine(ttlLine_),
-			state(state_)
-		{}
-		int64 sampleNumber;
-		uint8 ttlLine;
-		bool state;
+		int64 sampleNumber = 0;		// in the event's source stream
+		uint64 framePosition = 0;	// analog output buffer position it is output with
+		uint8 ttlLine = 0;
+		bool state = false;
 	};
 
-	CriticalSection lock;
+	/* Events for the sample-clocked digital output task, from the GUI thread to the writer thread;
+	   null unless synchronized digital output is running */
+	std::unique_ptr<CircularBuffer<OutputEvent>> outputEvents;
+
+	/* The digital output task clocked by /ao/SampleClock, if any, and its port */
+	NIDAQ::TaskHandle clockedDOTask = 0;
+	int clockedPort = -1;
+
+	/* Writer thread: fills numFrames digital output samples for the frames from position on,
+	   applying queued events; only the first numSourceFrames are real buffer frames, the
+	   rest (padding) hold the port state */
+	void fillDigitalChunk(uint64 position, int numSourceFrames, NIDAQ::uInt32* data, int numFrames);
+
+	/* Writer thread: the next queued event, if any, in nextEvent */
+	bool peekOutputEvent();
+
+	OutputEvent nextEvent;
+	bool hasNextEvent = false;
+
+	/* Holds the GUI's float samples; conversion to volts happens on the writer thread */
+	typedef CircularBuffer<float> AnalogBuffer;
+	std::unique_ptr<AnalogBuffer> analogOutBuffer;
+
+	/* Index into aout of each analog output buffer channel / AO task channel */
+	Array<int> analogOutputIndices;
+
+	/* Input mix for each analog output buffer channel, fixed while acquiring */
+	std::vector<std::vector<RoutingTerm>> analogRoutes;
+
+	Array<float> inputStreamSampleRates;
+
+	/* Outputs fed by one data stream, held until every other stream has caught up */
+	struct StreamPath
+	{
+		int streamIndex = 0;
+		Array<int> bufferChannels;		// analog output buffer channels fed by this stream
+		AudioBuffer<float> pending;		// mixed frames, one channel per bufferChannels entry
+		int numPending = 0;
+		double nextSampleNumber = 0;	// source sample number of the first pending frame
+		int64 arrivalTicks = 0;			// when the first pending frame arrived
+
+		/* Converts the stream's rate to the analog output rate; null when they match */
+		std::unique_ptr<Resampler> resampler;
+		AudioBuffer<float> mixed;		// stream-rate mix waiting to be resampled into pending
+		std::vector<const float*> mixedChannels;
+		std::vector<float*> pendingChannels;
+		double nominalSamplesPerFrame = 1.0;	// stream rate / AO rate
+		double samplesPerFrame = 1.0;	// source samples per output frame, including any drift trim
+		bool hasStarted = false;
+		int blockFirstFrame = 0;		// pending frame the latest block starts at
+	};
+
+	OwnedArray<StreamPath> streamPaths;
+
+	/* Analog output buffer channels whose source stream doesn't exist */
+	Array<int> silentAnalogChannels;
+
+	StreamPath* getStreamPath(int streamIndex);
+	void discardPendingFrames(StreamPath* path, int numFrames);
+
+	/* (Re)creates the analog output buffer for the current sample rate and settings */
+	void allocateAnalogBuffer(int numChannels);
+
+	/* Creates the analog output buffer and stream paths once the AO sample rate is known */
+	void prepareAnalogStreams();
+
+	/* Sets the chunk size and the AO task's buffering for the output mode */
+	NIDAQ::int32 configureOutputMode();
+
+	/* How a DAQmx_AO_DataXferReqCond value reads in the latency log */
+	static String getTransferConditionName(NIDAQ::int32 condition);
+
+	/* Starts the digital output tasks, then the AO task (whose sample clock drives any clocked DO task) */
+	NIDAQ::int32 startOutputTasks();
+
+	/* Frames written to the AO task before it starts */
+	int getPrimeFrames();
+
+	/* Writer thread: applies the priority and core settings to itself and reports the outcome */
+	void applyWriterScheduling();
+
+	/* A software-timed digital output change, and when it was queued */
+	struct DigitalCommand
+	{
+		int channelIdx = 0;
+		bool state = false;
+		int64 queuedTicks = 0;
+	};
+
+	CommandQueue<DigitalCommand> digitalCommands { 1024 };
+
+	std::unique_ptr<DigitalOutputThread> digitalWriter;
+
+	friend class DigitalOutputThread;
+
+	/* Port number and bit of each digital output line (dout index) */
+	Array<int> digitalLinePorts;
+	Array<int> digitalLineBits;
+
+	/* Software-timed digital output task of each port, by port number (0 where there is none) */
+	std::vector<NIDAQ::TaskHandle> digitalPortTasks;
+
+	/* Current word of every port, by port number; the clocked port's is the writer thread's,
+	   the others the digital output thread's */
+	std::vector<NIDAQ::uInt32> digitalPortWords;
+
+	/* Digital output thread: writes a port's word, digitalWriteSize bits wide */
+	void writeDigitalPort(int port);
+
+	std::atomic<bool> hasUnflushedDigitalWrites { false };
+	std::atomic<int> digitalCoalescingMs { 0 };
+
+	/* Digital output thread only */
+	double totalDigitalQueueMs = 0;
+	double totalDigitalWriteMs = 0;
+	int64 numDigitalWrites = 0;
+	int64 numDigitalChanges = 0;
+
+	std::atomic<double> lastDigitalQueueMs { 0 };
+	std::atomic<double> maxDigitalQueueMs { 0 };
+	std::atomic<double> lastDigitalWriteMs { 0 };
+	std::atomic<double> maxDigitalWriteMs { 0 };
+
+	NIDAQ::uInt32 hostBufferFrames = 0;
+	NIDAQ::uInt32 onboardBufferFrames = 0;
+	NIDAQ::int32 transferCondition = 0;	// DAQmx_AO_DataXferReqCond the AO task ended up with
+	double worstCaseOutputLatencyMs = 0;
+
+	/* Where a block passed to flushAnalogStreams() landed in the analog output buffer */
+	struct BlockTag
+	{
+		double sampleNumber = 0;	// source sample number of the block's first sample
+		uint64 framePosition = 0;	// analog output buffer position of that sample
+		uint32 numFrames = 0;
+		double samplesPerFrame = 1.0;	// source samples per output frame, including any drift trim
+		int64 arrivalTicks = 0;		// high-resolution ticks when the block was buffered
+	};
 
-	OwnedArray<OutputEvent> eventBuffer;
-	std::unique_ptr<CircularBuffer<double>> analogOutBuffer;
+	std::unique_ptr<CircularBuffer<BlockTag>> blockTags;
+
+	/* Writer thread: maps a chunk about to be written back to its source samples */
+	void noteFramesWritten(uint64 framePosition, int numFrames);
+
+	/* Drift compensation, run from flushAnalogStreams() after numFrames were buffered */
+	void updateDriftCompensation(int numFrames);
+
+	double driftElapsedSeconds = 0;
+	double filteredBufferFill = 0;		// frames
+	double targetBufferFill = 0;		// frames
+	bool hasDriftTarget = false;
+	double driftIntegral = 0;			// seconds of latency error x seconds
+
+	/* Writer thread: picks the next chunk size from the device's queue, or returns 0 (after
+	   waiting a little) while the device still has more than the target queued */
+	int getNextWriteChunk(NIDAQ::uInt64 framesWritten);
+
+	/* Every-N-samples callback, on a driver thread: wakes the writer thread */
+	static NIDAQ::int32 CVICALLBACK onSamplesTransferred(NIDAQ::TaskHandle taskHandle, NIDAQ::int32 eventType, NIDAQ::uInt32 numSamples, void* callbackData);
+
+	/* Writer thread, event-driven writes: the frames needed to bring the device's queue back up
+	   to targetFrames, limited to what the analog output buffer holds, or 0 (after waiting for
+	   the next event) if nothing should be written yet */
+	int getNextEventWrite(NIDAQ::uInt64 framesWritten, int targetFrames);
+
+	bool hasWriteEvents = false;	// the callback is registered on the AO task
+
+	/* Writer thread only */
+	int minChunkFrames = 0;
+	int maxChunkFrames = 0;
+	double backlogTargetFrames = 0;
+	uint32 lastUnderflowTime = 0;
+	uint32 lastTargetChangeTime = 0;
+	uint64 lastDeviceUnderflows = 0;
+	bool wasBacklogLow = false;
+
+	BlockTag currentTag;
+	BlockTag nextTag;
+	bool hasCurrentTag = false;
+	bool hasNextTag = false;
+
+	double maxBufferLatencyMs = 0;
+	double totalBufferLatencyMs = 0;
+	int64 numLatencyMeasurements = 0;
+
+	std::atomic<uint64> numClippedSamples { 0 };
+
+	std::atomic<int64> lastWrittenSampleNumber { -1 };
+	std::atomic<double> lastBufferLatencyMs { 0 };
+	std::atomic<double> clockDriftPpm { 0 };
+	std::atomic<uint64> numDeviceUnderflows { 0 };
+	std::atomic<uint64> numLateSamples { 0 };
+	std::atomic<uint32> writeChunkFrames { 0 };
+	std::atomic<uint32> deviceBacklogTarget { 0 };
+	std::atomic<uint64> numBacklogUnderruns { 0 };
+	std::atomic<uint64> numWriteEvents { 0 };
+	std::atomic<bool> writerIsRealtime { false };
+	std::atomic<bool> writerIsPinned { false };
+	std::atomic<bool> processMemoryLocked { false };
+
+	OverrunPolicy overrunPolicy = OverrunPolicy::DROP_OLDEST;
+	UnderrunPolicy underrunPolicy = UnderrunPolicy::WAIT;
+
+	int maxLatencyMs = 250;
+	bool lockBufferMemory = false;
+
+	int writerPriority = 0;
+	int writerCore = -1;
+	bool lockProcessMemory = false;
+
+	AO_DATA_FORMAT analogDataFormat = SCALED_F64;
+	AO_OUTPUT_MODE outputMode = STANDARD_OUTPUT;
+
+	bool driftCompensation = false;
+	bool adaptiveChunking = false;
+	bool eventDrivenWrites = false;
+
+	int primeMs = 0;
+	PRIME_SOURCE primeSource = PRIME_WITH_ZEROS;
 
 	bool sendSynchronizedEvents = false;
 
@@ -74,20 +74,32 @@ int NIDAQOutput::openConnection()
 
     mNIDAQ = new NIDAQmx(dm->getDeviceAtIndex(deviceIndex));
 
-    sampleRateIndex = mNIDAQ->sampleRates.size() - 1;
-    setSampleRate(sampleRateIndex);
-
     voltageRangeIndex = mNIDAQ->device->voltageRanges.size() - 1;
     setVoltageRange(voltageRangeIndex);
 
+    setOverrunPolicy(overrunPolicy);
+    setUnderrunPolicy(underrunPolicy);
+    setMaxLatency(maxLatencyMs);
+    setLockBufferMemory(lockBufferMemory);
+    setWriterPriority(writerPriority);
+    setWriterCore(writerCore);
+    setLockProcessMemory(lockProcessMemory);
+    setDigitalCoalescingWindow(digitalCoalescingMs);
+    setAnalogDataFormat(analogDataFormat);
+    setOutputMode(outputMode);
+    setDriftCompensation(driftCompensation);
+    setAdaptiveChunking(adaptiveChunking);
+    setEventDrivenWrites(eventDrivenWrites);
+    setPrimeLength(primeMs);
+    setPrimeSource(primeSource);
+
     return 0;
 
 }
 
-void NIDAQOutput::setSampleRate(int rateIndex)
+void NIDAQOutput::setSampleRate(NIDAQ::float64 rate)
 {
-    sampleRateIndex = rateIndex;
-    mNIDAQ->setSampleRate(rateIndex);
+    mNIDAQ->setSampleRate(rate);
 }
 
 Array<SettingsRange> NIDAQOutput::getVoltageRanges()
@@ -101,9 +113,120 @@ void NIDAQOutput::setVoltageRange(int rangeIndex)
     mNIDAQ->setVoltageRange(rangeIndex);
 }
 
+void NIDAQOutput::setOverrunPolicy(OverrunPolicy policy)
+{
+    // The audio thread is the producer and must never wait for the writer; BLOCK (from older
+    // settings) drops the newest frames straight away instead, as it would on timeout
+    if (policy == OverrunPolicy::BLOCK)
+        policy = OverrunPolicy::DROP_NEWEST;
+
+    overrunPolicy = policy;
+    mNIDAQ->setOverrunPolicy(policy);
+}
+
+void NIDAQOutput::setUnderrunPolicy(UnderrunPolicy policy)
+{
+    underrunPolicy = policy;
+    mNIDAQ->setUnderrunPolicy(policy);
+}
+
+void NIDAQOutput::setMaxLatency(int ms)
+{
+    maxLatencyMs = ms;
+    mNIDAQ->setMaxLatency(ms);
+}
+
+void NIDAQOutput::setLockBufferMemory(bool shouldLock)
+{
+    lockBufferMemory = shouldLock;
+    mNIDAQ->setLockBufferMemory(shouldLock);
+}
+
+void NIDAQOutput::setAnalogDataFormat(AO_DATA_FORMAT format)
+{
+    analogDataFormat = format;
+    mNIDAQ->setAnalogDataFormat(format);
+}
+
+void NIDAQOutput::setOutputMode(AO_OUTPUT_MODE mode)
+{
+    outputMode = mode;
+    mNIDAQ->setOutputMode(mode);
+}
+
+void NIDAQOutput::setDriftCompensation(bool shouldCompensate)
+{
+    driftCompensation = shouldCompensate;
+    mNIDAQ->setDriftCompensation(shouldCompensate);
+}
+
+void NIDAQOutput::setAdaptiveChunking(bool shouldAdapt)
+{
+    adaptiveChunking = shouldAdapt;
+    mNIDAQ->setAdaptiveChunking(shouldAdapt);
+}
+
+void NIDAQOutput::setWriterPriority(int priority)
+{
+    writerPriority = priority;
+    mNIDAQ->setWriterPriority(priority);
+}
+
+void NIDAQOutput::setWriterCore(int core)
+{
+    writerCore = core;
+    mNIDAQ->setWriterCore(core);
+}
+
+void NIDAQOutput::setLockProcessMemory(bool shouldLock)
+{
+    lockProcessMemory = shouldLock;
+    mNIDAQ->setLockProcessMemory(shouldLock);
+}
+
+void NIDAQOutput::setDigitalCoalescingWindow(int ms)
+{
+    digitalCoalescingMs = ms;
+    mNIDAQ->setDigitalCoalescingWindow(ms);
+}
+
+void NIDAQOutput::setEventDrivenWrites(bool shouldUseEvents)
+{
+    eventDrivenWrites = shouldUseEvents;
+    mNIDAQ->setEventDrivenWrites(shouldUseEvents);
+}
+
+void NIDAQOutput::setPrimeLength(int ms)
+{
+    primeMs = ms;
+    mNIDAQ->setPrimeLength(ms);
+}
+
+void NIDAQOutput::setPrimeSource(PRIME_SOURCE source)
+{
+    primeSource = source;
+    mNIDAQ->setPrimeSource(source);
+}
+
+bool NIDAQOutput::setAnalogRouting(int id, String expression)
+{
+    if (id >= mNIDAQ->aout.size())
+        return false;
+
+    if (!mNIDAQ->aout[id]->setRouting(expression))
+    {
+        LOGE("Invalid routing for AO", id, ": ", expression);
+        return false;
+    }
+
+    return true;
+}
+
 void NIDAQOutput::updateAnalogChannels()
 {
-    //TODO 
+    // Only the outputs shown in the editor can be enabled
+    for (int i = 0; i < mNIDAQ->aout.size(); i++)
+        mNIDAQ->aout[i]->setEnabled(i < getNumActiveAnalogOutputs());
 }
 
 void NIDAQOutput::updateDigitalChannels()
@@ -118,6 +241,11 @@ void NIDAQOutput::updateSettings()
 
 bool NIDAQOutput::startAcquisition()
 {
+    Array<float> streamSampleRates;
+    for (auto stream : dataStreams)
+        streamSampleRates.add(stream->getSampleRate());
+    mNIDAQ->setInputStreams(streamSampleRates);
+
     LOGD("Starting Tasks...");
     mNIDAQ->startTasks();
     return true;
@@ -125,17 +253,18 @@ bool NIDAQOutput::startAcquisition()
 
 bool NIDAQOutput::stopAcquisition()
 {
+    mNIDAQ->stopDigitalWriter();
     mNIDAQ->stopThread(5000);
+    mNIDAQ->clearTasks();
+    mNIDAQ->unlockProcessMemory();
     return true;
 }
 
 void NIDAQOutput::process (AudioBuffer<float>& buffer)
 {
-    /* Check for events */
-    checkForEvents();
-
-    /* Mirror analog output from first input channel on first stream */
+    /* Queue each stream for the analog outputs that follow it, mixed by each output's routing */
     int streamIdx = 0;
+    int firstChannel = 0;
     for (auto stream : dataStreams)
     {
 
@@ -144,23 +273,38 @@ void NIDAQOutput::process (AudioBuffer<float>& buffer)
 
         uint32 numSamples = getNumSamplesInBlock(streamId);
 
-        if (streamIdx == 0)
-        {
-            mNIDAQ->analogWrite(buffer, numSamples);
-        }
+        mNIDAQ->analogWrite(streamIdx, buffer, firstChannel, stream->getChannelCount(), numSamples, firstSampleNumber);
+
+        firstChannel += stream->getChannelCount();
         streamIdx++;
 
     }
+
+    /* Check for events; synchronized ones are placed among the frames queued above */
+    checkForEvents();
+
+    /* Software-timed events of this block go out together */
+    mNIDAQ->flushDigitalWrites();
+
+    /* Send what all source streams have delivered to the device */
+    mNIDAQ->flushAnalogStreams();
 }
 
 void NIDAQOutput::handleTTLEvent(TTLEventPtr event)
 {
     const int eventBit = event->getLine() + 1;
-    DataStream* stream = getDataStream(event->getStreamId());
     int64 firstSampleNumber = getFirstSampleNumberForBlock(event->getStreamId());
 
+    int streamIdx = 0;
+    for (auto stream : dataStreams)
+    {
+        if (stream->getStreamId() == event->getStreamId())
+            break;
+        streamIdx++;
+    }
+
     if (mNIDAQ->sendsSynchronizedEvents())
-	    mNIDAQ->addEvent(event->getSampleNumber(), eventBit, event->getState());
+	    mNIDAQ->addEvent(streamIdx, event->getSampleNumber(), firstSampleNumber, eventBit, event->getState());
     else
         mNIDAQ->digitalWrite(eventBit, event->getState());
 }
\ No newline at end of file
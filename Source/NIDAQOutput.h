@@ -61,15 +61,16 @@ public:
     /** Sets the voltage range of the data source. */
     void setVoltageRange(int rangeIndex);
 
-    /** Get available sample rates for current device */
+    /** Get preset sample rates for current device; any rate in getSampleRateRange() can be set */
     Array<NIDAQ::float64> getSampleRates() { return mNIDAQ->sampleRates; };
+    SettingsRange getSampleRateRange() { return mNIDAQ->getSampleRateRange(); };
 
-    /** Get the current sample rate */
+    /** Get the current sample rate (the device's coerced rate once acquisition has started) */
     NIDAQ::float64 getSampleRate() { return mNIDAQ->getSampleRate(); };
-    int getSampleRateIndex() { return sampleRateIndex; };
+    NIDAQ::float64 getRequestedSampleRate() { return mNIDAQ->getRequestedSampleRate(); };
 
-    /** Sets the sample rate of the data source. */
-    void setSampleRate(int rateIndex);
+    /** Sets the sample rate of the analog outputs. */
+    void setSampleRate(NIDAQ::float64 rate);
 
     /** Returns total number of available analog inputs on device */
 	int getTotalAvailableAnalogOutputs() { return mNIDAQ->device->numAOChannels; }; 
@@ -103,8 +104,88 @@ public:
 
     SOURCE_TYPE getSourceTypeForOutput(int outputIndex) { return mNIDAQ->getSourceTypeForOutput(outputIndex); };
 
-    /** Set Analog channel enabled state */
-    void setAnalogEnable(int id, bool enabled) { mNIDAQ->aout[id]->setEnabled(enabled); };
+    /** Get/set what the analog output buffer does when it is full or empty */
+    OverrunPolicy getOverrunPolicy() { return overrunPolicy; };
+    void setOverrunPolicy(OverrunPolicy policy);
+
+    UnderrunPolicy getUnderrunPolicy() { return underrunPolicy; };
+    void setUnderrunPolicy(UnderrunPolicy policy);
+
+    /** Get/set the longest output latency the analog output buffer may hold (ms) */
+    int getMaxLatency() { return maxLatencyMs; };
+    void setMaxLatency(int ms);
+
+    /** Get/set whether the analog output buffer is pinned in RAM */
+    bool getLockBufferMemory() { return lockBufferMemory; };
+    void setLockBufferMemory(bool shouldLock);
+
+    /** Get/set whether analog samples are written as volts or raw DAC codes */
+    AO_DATA_FORMAT getAnalogDataFormat() { return analogDataFormat; };
+    void setAnalogDataFormat(AO_DATA_FORMAT format);
+
+    /** Get/set the latency/throughput trade-off of the AO task */
+    AO_OUTPUT_MODE getOutputMode() { return outputMode; };
+    void setOutputMode(AO_OUTPUT_MODE mode);
+
+    /** True if the device can do hardware-timed single point output (SINGLE_POINT_OUTPUT) */
+    bool supportsSinglePointOutput() { return mNIDAQ->device->supportsSinglePointOutput; };
+
+    /** Worst-case time from process() to the DAC with the current buffering (ms) */
+    double getWorstCaseOutputLatency() { return mNIDAQ->getWorstCaseOutputLatency(); };
+
+    /** Get/set whether the writer adapts its chunk size to the device's queue */
+    bool getAdaptiveChunking() { return adaptiveChunking; };
+    void setAdaptiveChunking(bool shouldAdapt);
+
+    /** Get/set the writer thread's real-time priority (0 for normal scheduling) and CPU core (-1 for any) */
+    int getWriterPriority() { return writerPriority; };
+    void setWriterPriority(int priority);
+
+    int getWriterCore() { return writerCore; };
+    void setWriterCore(int core);
+
+    /** Get/set whether all process memory is locked in RAM while acquiring */
+    bool getLockProcessMemory() { return lockProcessMemory; };
+    void setLockProcessMemory(bool shouldLock);
+
+    /** Whether the writer scheduling and memory locking took effect for the current acquisition */
+    bool isWriterRealtime() { return mNIDAQ->isWriterRealtime(); };
+    bool isWriterPinned() { return mNIDAQ->isWriterPinned(); };
+    bool isProcessMemoryLocked() { return mNIDAQ->isProcessMemoryLocked(); };
+
+    /** Get/set the window within which software-timed TTL changes are merged into one write per port (ms, 0 for per block) */
+    int getDigitalCoalescingWindow() { return digitalCoalescingMs; };
+    void setDigitalCoalescingWindow(int ms);
+
+    /** Get/set whether the writer waits for the device's every-N-samples events instead of polling */
+    bool getEventDrivenWrites() { return eventDrivenWrites; };
+    void setEventDrivenWrites(bool shouldUseEvents);
+
+    /** Get/set how much output is queued before the AO and DO tasks start, and what it is */
+    int getPrimeLength() { return primeMs; };
+    void setPrimeLength(int ms);
+
+    PRIME_SOURCE getPrimeSource() { return primeSource; };
+    void setPrimeSource(PRIME_SOURCE source);
+
+    /** Get/set whether the analog outputs track clock drift between the source and the device */
+    bool getDriftCompensation() { return driftCompensation; };
+    void setDriftCompensation(bool shouldCompensate);
+
+    /** Estimated source clock offset from the AO sample clock (ppm) */
+    double getClockDriftPpm() { return mNIDAQ->getClockDriftPpm(); };
+
+    /** Get/set Analog channel enabled state; enabled outputs are written from the next acquisition */
+    bool isAnalogOutputEnabled(int id) { return id < mNIDAQ->aout.size() && mNIDAQ->aout[id]->isEnabled(); };
+    void setAnalogEnable(int id, bool enabled) { if (id < mNIDAQ->aout.size()) mNIDAQ->aout[id]->setEnabled(enabled); };
+
+    /** Get/set the input channel mix sent to an analog output (see AnalogOutput::setRouting) */
+    String getAnalogRouting(int id) { return id < mNIDAQ->aout.size() ? mNIDAQ->aout[id]->getRoutingExpression() : String(); };
+    bool setAnalogRouting(int id, String expression);
+
+    /** Get/set the index of the data stream an analog output follows */
+    int getAnalogSourceStream(int id) { return id < mNIDAQ->aout.size() ? mNIDAQ->aout[id]->getSourceStream() : 0; };
+    void setAnalogSourceStream(int id, int streamIndex) { if (id < mNIDAQ->aout.size()) mNIDAQ->aout[id]->setSourceStream(streamIndex); };
 
     /** Set Digital channel enabled state */
     void setDigitalEnable(int id, bool enabled) { mNIDAQ->dout[id]->setEnabled(enabled); };
@@ -145,9 +226,30 @@ private:
     ScopedPointer<NIDAQmx> mNIDAQ;
 
     int deviceIndex = 0;
-    int sampleRateIndex = 0;
     int voltageRangeIndex = 0;
 
+    OverrunPolicy overrunPolicy = OverrunPolicy::DROP_OLDEST;
+    UnderrunPolicy underrunPolicy = UnderrunPolicy::WAIT;
+
+    int maxLatencyMs = 250;
+    bool lockBufferMemory = false;
+
+    AO_DATA_FORMAT analogDataFormat = SCALED_F64;
+    AO_OUTPUT_MODE outputMode = STANDARD_OUTPUT;
+
+    bool driftCompensation = false;
+    bool adaptiveChunking = false;
+    bool eventDrivenWrites = false;
+
+    int digitalCoalescingMs = 0;
+
+    int writerPriority = 0;
+    int writerCore = -1;
+    bool lockProcessMemory = false;
+
+    int primeMs = 0;
+    PRIME_SOURCE primeSource = PRIME_WITH_ZEROS;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (NIDAQOutput);
 };
 
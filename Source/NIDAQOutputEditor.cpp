@@ -145,7 +145,7 @@ void EditorBackground::paint(Graphics& g)
 
 }
 
-AOButton::AOButton(int id_, NIDAQOutput* processor_) : id(id_), processor(processor_), enabled(true)
+AOButton::AOButton(int id_, NIDAQOutput* processor_) : id(id_), processor(processor_), enabled(processor_->isAnalogOutputEnabled(id_))
 {
 	startTimer(500);
 }
@@ -383,14 +383,25 @@ void NIDAQOutputEditor::draw()
 	if (processor->getDevices().size() == 1)	// disable device selection if only one device is available
 		deviceSelectBox->setEnabled(false);
 
+	// Any rate in the device's range can be typed in; the input stream rates are offered
+	// first, since matching one exactly means that stream isn't resampled
 	sampleRateSelectBox = new ComboBox("SampleRateSelectBox");
 	sampleRateSelectBox->setBounds(xOffset, 70, 85, 20);
-	Array<NIDAQ::float64> sampleRates = processor->getSampleRates();
+	sampleRateSelectBox->setEditableText(true);
+	Array<NIDAQ::float64> sampleRates;
+	SettingsRange sampleRateRange = processor->getSampleRateRange();
+	for (auto stream : processor->getDataStreams())
+	{
+		if (stream->getSampleRate() >= sampleRateRange.min && stream->getSampleRate() <= sampleRateRange.max)
+			sampleRates.addIfNotAlreadyThere(stream->getSampleRate());
+	}
+	for (auto rate : processor->getSampleRates())
+		sampleRates.addIfNotAlreadyThere(rate);
 	for (int i = 0; i < sampleRates.size(); i++)
 	{
 		sampleRateSelectBox->addItem(String(sampleRates[i]) + " S/s", i + 1);
 	}
-	sampleRateSelectBox->setSelectedItemIndex(processor->getSampleRateIndex(), false);
+	sampleRateSelectBox->setText(String(processor->getRequestedSampleRate()) + " S/s", dontSendNotification);
 	sampleRateSelectBox->addListener(this);
 	addAndMakeVisible(sampleRateSelectBox);
 
@@ -460,6 +471,25 @@ void NIDAQOutputEditor::comboBoxChanged(ComboBox* comboBoxThatHasChanged)
         processor->setDevice(processor->getDevices()[deviceIndex]->getName());
         CoreServices::updateSignalChain(this);
     }
+	else if (comboBoxThatHasChanged == sampleRateSelectBox)
+	{
+		// Out-of-range rates are clamped; show the rate that will be requested. The
+		// running AO task, its buffers and resamplers all keep the rate they started with
+		double rate = sampleRateSelectBox->getText().getDoubleValue();
+		if (rate > 0 && !CoreServices::getAcquisitionStatus())
+			processor->setSampleRate(rate);
+		sampleRateSelectBox->setText(String(processor->getRequestedSampleRate()) + " S/s", dontSendNotification);
+	}
+}
+
+void NIDAQOutputEditor::startAcquisition()
+{
+	sampleRateSelectBox->setEnabled(false);
+}
+
+void NIDAQOutputEditor::stopAcquisition()
+{
+	sampleRateSelectBox->setEnabled(true);
 }
 
 void NIDAQOutputEditor::buttonClicked(Button* button)
@@ -472,10 +502,13 @@ void NIDAQOutputEditor::buttonEvent(Button* button)
 
 	if (aoButtons.contains((AOButton*)button))
 	{
-        /*
-		((AOButton*)button)->setEnabled(processor->toggleAIChannel(((AOButton*)button)->getId()));
-		repaint();
-        */
+		// The AO task is built when acquisition starts
+		if (!CoreServices::getAcquisitionStatus())
+		{
+			AOButton* aoButton = (AOButton*)button;
+			aoButton->setEnabled(!processor->isAnalogOutputEnabled(aoButton->getId()));
+			repaint();
+		}
 	}
 	else if (doButtons.contains((DOButton*)button))
 	{
@@ -580,22 +613,293 @@ PopupConfigurationWindow::PopupConfigurationWindow(NIDAQOutputEditor* editor_)
 	digitalWriteSelect->addListener(this);
 	addAndMakeVisible(digitalWriteSelect);
 
+	overrunPolicyLabel = new Label("Buffer Full", "Buffer full: ");
+	overrunPolicyLabel->setColour(Label::textColourId, Colours::white);
+	overrunPolicyLabel->setBounds(2, 83, 110, 20);
+	addAndMakeVisible(overrunPolicyLabel);
+
+	overrunPolicySelect = new ComboBox("Buffer Full Policy Selector");
+	overrunPolicySelect->addItem("Drop oldest", int(OverrunPolicy::DROP_OLDEST) + 1);
+	overrunPolicySelect->addItem("Drop newest", int(OverrunPolicy::DROP_NEWEST) + 1);
+	overrunPolicySelect->setSelectedId(int(editor->getOverrunPolicy()) + 1, dontSendNotification);
+	overrunPolicySelect->setBounds(115, 83, 100, 20);
+	overrunPolicySelect->addListener(this);
+	addAndMakeVisible(overrunPolicySelect);
+
+	underrunPolicyLabel = new Label("Buffer Empty", "Buffer empty: ");
+	underrunPolicyLabel->setColour(Label::textColourId, Colours::white);
+	underrunPolicyLabel->setBounds(2, 108, 110, 20);
+	addAndMakeVisible(underrunPolicyLabel);
+
+	underrunPolicySelect = new ComboBox("Buffer Empty Policy Selector");
+	underrunPolicySelect->addItem("Zero fill", int(UnderrunPolicy::ZERO_FILL) + 1);
+	underrunPolicySelect->addItem("Hold last", int(UnderrunPolicy::HOLD_LAST) + 1);
+	underrunPolicySelect->addItem("Wait", int(UnderrunPolicy::WAIT) + 1);
+	underrunPolicySelect->setSelectedId(int(editor->getUnderrunPolicy()) + 1, dontSendNotification);
+	underrunPolicySelect->setBounds(115, 108, 100, 20);
+	underrunPolicySelect->addListener(this);
+	addAndMakeVisible(underrunPolicySelect);
+
+	maxLatencyLabel = new Label("Max Latency", "Max latency: ");
+	maxLatencyLabel->setColour(Label::textColourId, Colours::white);
+	maxLatencyLabel->setBounds(2, 133, 110, 20);
+	addAndMakeVisible(maxLatencyLabel);
+
+	maxLatencySelect = new ComboBox("Max Latency Selector");
+	Array<int> maxLatencyOptions = { 50, 100, 250, 500, 1000, 2000 };
+	for (int i = 0; i < maxLatencyOptions.size(); i++)
+	{
+		maxLatencySelect->addItem(String(maxLatencyOptions[i]) + " ms", maxLatencyOptions[i]);
+		if (maxLatencyOptions[i] == editor->getMaxLatency())
+			maxLatencySelect->setSelectedId(maxLatencyOptions[i], dontSendNotification);
+	}
+	maxLatencySelect->setBounds(115, 133, 100, 20);
+	maxLatencySelect->addListener(this);
+	addAndMakeVisible(maxLatencySelect);
+
+	analogDataFormatLabel = new Label("AO Data", "AO data: ");
+	analogDataFormatLabel->setColour(Label::textColourId, Colours::white);
+	analogDataFormatLabel->setBounds(2, 158, 110, 20);
+	addAndMakeVisible(analogDataFormatLabel);
+
+	analogDataFormatSelect = new ComboBox("AO Data Format Selector");
+	analogDataFormatSelect->addItem("Volts (F64)", SCALED_F64 + 1);
+	analogDataFormatSelect->addItem("DAC codes (I16)", RAW_I16 + 1);
+	analogDataFormatSelect->setSelectedId(editor->getAnalogDataFormat() + 1, dontSendNotification);
+	analogDataFormatSelect->setBounds(115, 158, 100, 20);
+	analogDataFormatSelect->addListener(this);
+	addAndMakeVisible(analogDataFormatSelect);
+
+	outputModeLabel = new Label("Output Mode", "Output mode: ");
+	outputModeLabel->setColour(Label::textColourId, Colours::white);
+	outputModeLabel->setBounds(2, 183, 110, 20);
+	addAndMakeVisible(outputModeLabel);
+
+	outputModeSelect = new ComboBox("Output Mode Selector");
+	outputModeSelect->addItem("Standard", STANDARD_OUTPUT + 1);
+	outputModeSelect->addItem("Low latency", LOW_LATENCY_OUTPUT + 1);
+	outputModeSelect->addItem("Throughput", HIGH_THROUGHPUT_OUTPUT + 1);
+	if (editor->supportsSinglePointOutput())
+		outputModeSelect->addItem("Single point", SINGLE_POINT_OUTPUT + 1);
+	outputModeSelect->setSelectedId(editor->getOutputMode() + 1, dontSendNotification);
+	outputModeSelect->setBounds(115, 183, 100, 20);
+	outputModeSelect->addListener(this);
+	addAndMakeVisible(outputModeSelect);
+
+	lockMemoryButton = new ToggleButton("Lock buffer in memory");
+	lockMemoryButton->setColour(ToggleButton::textColourId, Colours::white);
+	lockMemoryButton->setBounds(2, 208, 213, 20);
+	lockMemoryButton->setToggleState(editor->getLockBufferMemory(), dontSendNotification);
+	lockMemoryButton->addListener(this);
+	addAndMakeVisible(lockMemoryButton);
+
+	driftCompensationButton = new ToggleButton("Track clock drift");
+	driftCompensationButton->setColour(ToggleButton::textColourId, Colours::white);
+	driftCompensationButton->setBounds(2, 233, 213, 20);
+	driftCompensationButton->setToggleState(editor->getDriftCompensation(), dontSendNotification);
+	driftCompensationButton->addListener(this);
+	addAndMakeVisible(driftCompensationButton);
+
+	adaptiveChunkingButton = new ToggleButton("Adaptive chunk size");
+	adaptiveChunkingButton->setColour(ToggleButton::textColourId, Colours::white);
+	adaptiveChunkingButton->setBounds(2, 258, 213, 20);
+	adaptiveChunkingButton->setToggleState(editor->getAdaptiveChunking(), dontSendNotification);
+	adaptiveChunkingButton->addListener(this);
+	addAndMakeVisible(adaptiveChunkingButton);
+
+	eventDrivenWritesButton = new ToggleButton("Write on device events");
+	eventDrivenWritesButton->setColour(ToggleButton::textColourId, Colours::white);
+	eventDrivenWritesButton->setBounds(2, 283, 213, 20);
+	eventDrivenWritesButton->setToggleState(editor->getEventDrivenWrites(), dontSendNotification);
+	eventDrivenWritesButton->addListener(this);
+	addAndMakeVisible(eventDrivenWritesButton);
+
+	// Output queued on the device before the tasks start; "Min" is a single chunk
+	primeLabel = new Label("Prime", "Prime: ");
+	primeLabel->setColour(Label::textColourId, Colours::white);
+	primeLabel->setBounds(2, 308, 50, 20);
+	addAndMakeVisible(primeLabel);
+
+	primeLengthSelect = new ComboBox("Prime Length Selector");
+	primeLengthSelect->addItem("Min", 1);
+	Array<int> primeLengthOptions = { 5, 10, 20, 50, 100 };
+	for (int i = 0; i < primeLengthOptions.size(); i++)
+		primeLengthSelect->addItem(String(primeLengthOptions[i]) + " ms", primeLengthOptions[i] + 1);
+	primeLengthSelect->setSelectedId(editor->getPrimeLength() + 1, dontSendNotification);
+	primeLengthSelect->setBounds(50, 308, 60, 20);
+	primeLengthSelect->addListener(this);
+	addAndMakeVisible(primeLengthSelect);
+
+	primeSourceSelect = new ComboBox("Prime Source Selector");
+	primeSourceSelect->addItem("Zeros", PRIME_WITH_ZEROS + 1);
+	primeSourceSelect->addItem("First samples", PRIME_WITH_SAMPLES + 1);
+	primeSourceSelect->setSelectedId(editor->getPrimeSource() + 1, dontSendNotification);
+	primeSourceSelect->setBounds(115, 308, 100, 20);
+	primeSourceSelect->addListener(this);
+	addAndMakeVisible(primeSourceSelect);
+
+	// Writer thread scheduling: real-time priority and CPU core
+	writerLabel = new Label("Writer", "Writer: ");
+	writerLabel->setColour(Label::textColourId, Colours::white);
+	writerLabel->setBounds(2, 333, 50, 20);
+	addAndMakeVisible(writerLabel);
+
+	writerPrioritySelect = new ComboBox("Writer Priority Selector");
+	writerPrioritySelect->addItem("Normal", 1);
+	Array<int> writerPriorityOptions = { 10, 50, 80, 95 };
+	for (int i = 0; i < writerPriorityOptions.size(); i++)
+		writerPrioritySelect->addItem("RT " + String(writerPriorityOptions[i]), writerPriorityOptions[i] + 1);
+	writerPrioritySelect->setSelectedId(editor->getWriterPriority() + 1, dontSendNotification);
+	writerPrioritySelect->setBounds(50, 333, 60, 20);
+	writerPrioritySelect->addListener(this);
+	addAndMakeVisible(writerPrioritySelect);
+
+	writerCoreSelect = new ComboBox("Writer Core Selector");
+	writerCoreSelect->addItem("Any core", 1);
+	for (int i = 0; i < SystemStats::getNumCpus(); i++)
+		writerCoreSelect->addItem("Core " + String(i), i + 2);
+	writerCoreSelect->setSelectedId(editor->getWriterCore() + 2, dontSendNotification);
+	writerCoreSelect->setBounds(115, 333, 100, 20);
+	writerCoreSelect->addListener(this);
+	addAndMakeVisible(writerCoreSelect);
+
+	lockProcessMemoryButton = new ToggleButton("Lock process memory");
+	lockProcessMemoryButton->setColour(ToggleButton::textColourId, Colours::white);
+	lockProcessMemoryButton->setBounds(2, 358, 213, 20);
+	lockProcessMemoryButton->setToggleState(editor->getLockProcessMemory(), dontSendNotification);
+	lockProcessMemoryButton->addListener(this);
+	addAndMakeVisible(lockProcessMemoryButton);
+
+	// Software-timed TTL changes are written once per block, or once per window
+	digitalCoalescingLabel = new Label("TTL Merge", "TTL merge: ");
+	digitalCoalescingLabel->setColour(Label::textColourId, Colours::white);
+	digitalCoalescingLabel->setBounds(2, 383, 110, 20);
+	addAndMakeVisible(digitalCoalescingLabel);
+
+	digitalCoalescingSelect = new ComboBox("TTL Merge Selector");
+	digitalCoalescingSelect->addItem("Per block", 1);
+	Array<int> digitalCoalescingOptions = { 1, 2, 5, 10 };
+	for (int i = 0; i < digitalCoalescingOptions.size(); i++)
+		digitalCoalescingSelect->addItem(String(digitalCoalescingOptions[i]) + " ms", digitalCoalescingOptions[i] + 1);
+	digitalCoalescingSelect->setSelectedId(editor->getDigitalCoalescingWindow() + 1, dontSendNotification);
+	digitalCoalescingSelect->setBounds(115, 383, 100, 20);
+	digitalCoalescingSelect->addListener(this);
+	addAndMakeVisible(digitalCoalescingSelect);
+
+	routingLabel = new Label("Routing", "Route: ");
+	routingLabel->setColour(Label::textColourId, Colours::white);
+	routingLabel->setBounds(2, 408, 50, 20);
+	addAndMakeVisible(routingLabel);
+
+	routingOutputSelect = new ComboBox("Routing Output Selector");
+	for (int i = 0; i < editor->getNumAnalogOutputs(); i++)
+		routingOutputSelect->addItem("AO" + String(i), i + 1);
+	routingOutputSelect->setSelectedId(1, dontSendNotification);
+	routingOutputSelect->setBounds(50, 408, 60, 20);
+	routingOutputSelect->addListener(this);
+	addAndMakeVisible(routingOutputSelect);
+
+	// Weighted sum of 1-based input channels, e.g. "ch12 - ch13"
+	routingExpression = new Label("Routing Expression", editor->getAnalogRouting(0));
+	routingExpression->setColour(Label::textColourId, Colours::white);
+	routingExpression->setBounds(115, 408, 100, 20);
+	routingExpression->setEditable(true);
+	routingExpression->addListener(this);
+	addAndMakeVisible(routingExpression);
+
+	sourceStreamLabel = new Label("Source Stream", "Stream: ");
+	sourceStreamLabel->setColour(Label::textColourId, Colours::white);
+	sourceStreamLabel->setBounds(2, 433, 50, 20);
+	addAndMakeVisible(sourceStreamLabel);
+
+	// Routing channel numbers are within the selected stream
+	sourceStreamSelect = new ComboBox("Source Stream Selector");
+	Array<const DataStream*> dataStreams = editor->getDataStreams();
+	for (int i = 0; i < dataStreams.size(); i++)
+		sourceStreamSelect->addItem(dataStreams[i]->getName() + " (" + String(dataStreams[i]->getSampleRate()) + " Hz)", i + 1);
+	sourceStreamSelect->setSelectedId(editor->getAnalogSourceStream(0) + 1, dontSendNotification);
+	sourceStreamSelect->setBounds(50, 433, 165, 20);
+	sourceStreamSelect->addListener(this);
+	addAndMakeVisible(sourceStreamSelect);
+
 	for (int i = 0; i < editor->getNumPorts(); i++)
 	{
 		ToggleButton* button = new ToggleButton("P"+String(i));
-		button->setBounds(i * 60 + 5, 85, 58, 20);
+		button->setBounds(i * 60 + 5, 460, 58, 20);
 		button->addListener(this);
 		button->setToggleState(editor->getPortState(i), juce::dontSendNotification);
 		addAndMakeVisible(button);
 		digitalPortButtons.add(button);
 	}
 
-	setSize(180, 110);
+	setSize(220, 485);
 
 }
 
 void PopupConfigurationWindow::comboBoxChanged(ComboBox* comboBox)
 {
+	if (comboBox == overrunPolicySelect)
+	{
+		editor->setOverrunPolicy(OverrunPolicy(overrunPolicySelect->getSelectedId() - 1));
+		return;
+	}
+	else if (comboBox == underrunPolicySelect)
+	{
+		editor->setUnderrunPolicy(UnderrunPolicy(underrunPolicySelect->getSelectedId() - 1));
+		return;
+	}
+	else if (comboBox == maxLatencySelect)
+	{
+		editor->setMaxLatency(maxLatencySelect->getSelectedId());
+		return;
+	}
+	else if (comboBox == analogDataFormatSelect)
+	{
+		editor->setAnalogDataFormat(AO_DATA_FORMAT(analogDataFormatSelect->getSelectedId() - 1));
+		return;
+	}
+	else if (comboBox == outputModeSelect)
+	{
+		editor->setOutputMode(AO_OUTPUT_MODE(outputModeSelect->getSelectedId() - 1));
+		return;
+	}
+	else if (comboBox == primeLengthSelect)
+	{
+		editor->setPrimeLength(primeLengthSelect->getSelectedId() - 1);
+		return;
+	}
+	else if (comboBox == primeSourceSelect)
+	{
+		editor->setPrimeSource(PRIME_SOURCE(primeSourceSelect->getSelectedId() - 1));
+		return;
+	}
+	else if (comboBox == writerPrioritySelect)
+	{
+		editor->setWriterPriority(writerPrioritySelect->getSelectedId() - 1);
+		return;
+	}
+	else if (comboBox == writerCoreSelect)
+	{
+		editor->setWriterCore(writerCoreSelect->getSelectedId() - 2);
+		return;
+	}
+	else if (comboBox == digitalCoalescingSelect)
+	{
+		editor->setDigitalCoalescingWindow(digitalCoalescingSelect->getSelectedId() - 1);
+		return;
+	}
+	else if (comboBox == routingOutputSelect)
+	{
+		routingExpression->setText(editor->getAnalogRouting(routingOutputSelect->getSelectedId() - 1), dontSendNotification);
+		sourceStreamSelect->setSelectedId(editor->getAnalogSourceStream(routingOutputSelect->getSelectedId() - 1) + 1, dontSendNotification);
+		return;
+	}
+	else if (comboBox == sourceStreamSelect)
+	{
+		editor->setAnalogSourceStream(routingOutputSelect->getSelectedId() - 1, sourceStreamSelect->getSelectedId() - 1);
+		return;
+	}
+
 	int numAnalogOutputs = int(analogChannelCountSelect->getItemText(analogChannelCountSelect->getSelectedId() - 1).getFloatValue());
 	int numDigitalOutputs = int(digitalChannelCountSelect->getItemText(digitalChannelCountSelect->getSelectedId() - 1).getFloatValue());
 	int digitalWrite = int(digitalWriteSelect->getItemText(digitalWriteSelect->getSelectedId() - 1).getFloatValue());
@@ -614,8 +918,46 @@ void PopupConfigurationWindow::paint(juce::Graphics& g)
 	}
 }
 
+void PopupConfigurationWindow::labelTextChanged(Label* label)
+{
+	if (label == routingExpression)
+	{
+		int outputIndex = routingOutputSelect->getSelectedId() - 1;
+
+		// Show what is actually in use if the new expression was rejected
+		if (!editor->setAnalogRouting(outputIndex, routingExpression->getText()))
+			routingExpression->setText(editor->getAnalogRouting(outputIndex), dontSendNotification);
+	}
+}
+
 void PopupConfigurationWindow::buttonClicked(juce::Button* button)
 {
+	if (button == lockMemoryButton)
+	{
+		editor->setLockBufferMemory(button->getToggleState());
+		return;
+	}
+	else if (button == driftCompensationButton)
+	{
+		editor->setDriftCompensation(button->getToggleState());
+		return;
+	}
+	else if (button == adaptiveChunkingButton)
+	{
+		editor->setAdaptiveChunking(button->getToggleState());
+		return;
+	}
+	else if (button == lockProcessMemoryButton)
+	{
+		editor->setLockProcessMemory(button->getToggleState());
+		return;
+	}
+	else if (button == eventDrivenWritesButton)
+	{
+		editor->setEventDrivenWrites(button->getToggleState());
+		return;
+	}
+
 	int portIdx = button->getName().getLastCharacter()-'0';
 	editor->setPortState(portIdx, button->getToggleState());
 	repaint();
@@ -624,17 +966,48 @@ void PopupConfigurationWindow::buttonClicked(juce::Button* button)
 void NIDAQOutputEditor::saveCustomParametersToXml(XmlElement* xml)
 {
     xml->setAttribute("device", processor->getDeviceName());
-    xml->setAttribute("sampleRate", processor->getSampleRate());
+    xml->setAttribute("sampleRate", processor->getRequestedSampleRate());
 	xml->setAttribute("voltageRange", processor->getVoltageRangeIndex());
 
 	xml->setAttribute("numAnalog", getNumActiveAnalogOutputs());
 	xml->setAttribute("numDigital", getNumActiveDigitalOutputs());
 	xml->setAttribute("digitalWriteSize", getDigitalWriteSize());
 
+	String analogOutputStates = "";
+	for (int i = 0; i < getNumActiveAnalogOutputs(); i++)
+		analogOutputStates += processor->isAnalogOutputEnabled(i) ? "1" : "0";
+	xml->setAttribute("analogOutputStates", analogOutputStates);
+
+	StringArray analogRouting;
+	for (int i = 0; i < getNumAnalogOutputs(); i++)
+		analogRouting.add(getAnalogRouting(i));
+	xml->setAttribute("analogRouting", analogRouting.joinIntoString(";"));
+
+	StringArray analogSourceStreams;
+	for (int i = 0; i < getNumAnalogOutputs(); i++)
+		analogSourceStreams.add(String(getAnalogSourceStream(i)));
+	xml->setAttribute("analogSourceStreams", analogSourceStreams.joinIntoString(";"));
+
 	String digitalPortStates = "";
 	for (int i = 0; i < getNumPorts(); i++)
 		digitalPortStates += getPortState(i) ? "1" : "0";
 	xml->setAttribute("digitalPortStates", digitalPortStates);
+
+	xml->setAttribute("bufferFullPolicy", int(getOverrunPolicy()));
+	xml->setAttribute("bufferEmptyPolicy", int(getUnderrunPolicy()));
+	xml->setAttribute("maxLatencyMs", getMaxLatency());
+	xml->setAttribute("lockBufferMemory", getLockBufferMemory());
+	xml->setAttribute("analogDataFormat", int(getAnalogDataFormat()));
+	xml->setAttribute("outputMode", int(getOutputMode()));
+	xml->setAttribute("driftCompensation", getDriftCompensation());
+	xml->setAttribute("adaptiveChunking", getAdaptiveChunking());
+	xml->setAttribute("eventDrivenWrites", getEventDrivenWrites());
+	xml->setAttribute("writerPriority", getWriterPriority());
+	xml->setAttribute("writerCore", getWriterCore());
+	xml->setAttribute("lockProcessMemory", getLockProcessMemory());
+	xml->setAttribute("digitalCoalescingMs", getDigitalCoalescingWindow());
+	xml->setAttribute("primeMs", getPrimeLength());
+	xml->setAttribute("primeSource", int(getPrimeSource()));
 }
 
 void NIDAQOutputEditor::loadCustomParametersFromXml(XmlElement* xml)
@@ -642,22 +1015,14 @@ void NIDAQOutputEditor::loadCustomParametersFromXml(XmlElement* xml)
     processor->setDevice(xml->getStringAttribute("device", ""));
 	updateDevice(xml->getStringAttribute("device", ""));
 
-    float sampleRate = xml->getStringAttribute("sampleRate", "0.0").getFloatValue();
+    double sampleRate = xml->getStringAttribute("sampleRate", "0.0").getDoubleValue();
 
 	// Load sample rate
-	if (sampleRate > 0.0f)
+	if (sampleRate > 0.0)
 	{
-		int idx = 0;
-		for (auto& sr : processor->getSampleRates())
-		{
-			if (sr == sampleRate)
-			{
-				LOGD("Setting saved sample rate: " + String(sampleRate) + " (" + String(idx) + ")");
-				sampleRateSelectBox->setSelectedItemIndex(idx, true);
-				break;
-			}
-			idx++;
-		}
+		LOGD("Setting saved sample rate: " + String(sampleRate));
+		processor->setSampleRate(sampleRate);
+		sampleRateSelectBox->setText(String(processor->getRequestedSampleRate()) + " S/s", dontSendNotification);
 	}
 
 	// Load voltage range
@@ -678,6 +1043,24 @@ void NIDAQOutputEditor::loadCustomParametersFromXml(XmlElement* xml)
 		processor->updateAnalogChannels();
 	}
 
+	String analogOutputStates = xml->getStringAttribute("analogOutputStates", "");
+
+	for (int i = 0; i < analogOutputStates.length(); i++)
+		processor->setAnalogEnable(i, analogOutputStates[i] == '1');
+
+	// Load input channel routing, one expression per analog output
+	StringArray analogRouting;
+	analogRouting.addTokens(xml->getStringAttribute("analogRouting", ""), ";", "");
+
+	for (int i = 0; i < analogRouting.size(); i++)
+		processor->setAnalogRouting(i, analogRouting[i]);
+
+	StringArray analogSourceStreams;
+	analogSourceStreams.addTokens(xml->getStringAttribute("analogSourceStreams", ""), ";", "");
+
+	for (int i = 0; i < analogSourceStreams.size(); i++)
+		processor->setAnalogSourceStream(i, analogSourceStreams[i].getIntValue());
+
 	// Load number of active digital channels
 	int numDigital = xml->getStringAttribute("numDigital", "0").getIntValue();
 
@@ -700,6 +1083,56 @@ void NIDAQOutputEditor::loadCustomParametersFromXml(XmlElement* xml)
 	for (int i = 0; i < digitalPortStates.length(); i++)
 		processor->setPortState(i, digitalPortStates[i] == '1');
 
+	// Load analog output buffer policies
+	int bufferFullPolicy = xml->getStringAttribute("bufferFullPolicy", "-1").getIntValue();
+
+	if (bufferFullPolicy >= 0)
+		processor->setOverrunPolicy(OverrunPolicy(bufferFullPolicy));
+
+	int bufferEmptyPolicy = xml->getStringAttribute("bufferEmptyPolicy", "-1").getIntValue();
+
+	if (bufferEmptyPolicy >= 0)
+		processor->setUnderrunPolicy(UnderrunPolicy(bufferEmptyPolicy));
+
+	// Load analog output buffer sizing
+	int maxLatencyMs = xml->getStringAttribute("maxLatencyMs", "0").getIntValue();
+
+	if (maxLatencyMs > 0)
+		processor->setMaxLatency(maxLatencyMs);
+
+	processor->setLockBufferMemory(xml->getStringAttribute("lockBufferMemory", "0").getIntValue() != 0);
+
+	// Load analog output data format
+	int analogDataFormat = xml->getStringAttribute("analogDataFormat", "-1").getIntValue();
+
+	if (analogDataFormat >= 0)
+		processor->setAnalogDataFormat(AO_DATA_FORMAT(analogDataFormat));
+
+	int outputMode = xml->getStringAttribute("outputMode", "-1").getIntValue();
+
+	if (outputMode >= 0)
+		processor->setOutputMode(AO_OUTPUT_MODE(outputMode));
+
+	processor->setDriftCompensation(xml->getStringAttribute("driftCompensation", "0").getIntValue() != 0);
+	processor->setAdaptiveChunking(xml->getStringAttribute("adaptiveChunking", "0").getIntValue() != 0);
+	processor->setEventDrivenWrites(xml->getStringAttribute("eventDrivenWrites", "0").getIntValue() != 0);
+
+	// Load writer thread scheduling
+	processor->setWriterPriority(xml->getStringAttribute("writerPriority", "0").getIntValue());
+	processor->setWriterCore(xml->getStringAttribute("writerCore", "-1").getIntValue());
+	processor->setLockProcessMemory(xml->getStringAttribute("lockProcessMemory", "0").getIntValue() != 0);
+
+	// Load TTL coalescing
+	processor->setDigitalCoalescingWindow(xml->getStringAttribute("digitalCoalescingMs", "0").getIntValue());
+
+	// Load output priming
+	processor->setPrimeLength(xml->getStringAttribute("primeMs", "0").getIntValue());
+
+	int primeSource = xml->getStringAttribute("primeSource", "-1").getIntValue();
+
+	if (primeSource >= 0)
+		processor->setPrimeSource(PRIME_SOURCE(primeSource));
+
 	draw();
 
 }
\ No newline at end of file
@@ -117,7 +117,7 @@ private:
 
 };
 
-class PopupConfigurationWindow : public Component, public ComboBox::Listener, public Button::Listener
+class PopupConfigurationWindow : public Component, public ComboBox::Listener, public Button::Listener, public Label::Listener
 {
 
 public:
@@ -130,6 +130,7 @@ public:
 
 	void comboBoxChanged(ComboBox*);
 	void buttonClicked(Button* button) override;
+	void labelTextChanged(Label* label) override;
 
 	void paint(Graphics& g) override;
 
@@ -149,6 +150,45 @@ private:
 	ScopedPointer<Label> digitalPortsLabel;
 	ScopedPointer<ComboBox> digitalPortsSelect;
 
+	ScopedPointer<Label> overrunPolicyLabel;
+	ScopedPointer<ComboBox> overrunPolicySelect;
+
+	ScopedPointer<Label> underrunPolicyLabel;
+	ScopedPointer<ComboBox> underrunPolicySelect;
+
+	ScopedPointer<Label> maxLatencyLabel;
+	ScopedPointer<ComboBox> maxLatencySelect;
+
+	ScopedPointer<Label> analogDataFormatLabel;
+	ScopedPointer<ComboBox> analogDataFormatSelect;
+
+	ScopedPointer<Label> outputModeLabel;
+	ScopedPointer<ComboBox> outputModeSelect;
+
+	ScopedPointer<ToggleButton> lockMemoryButton;
+	ScopedPointer<ToggleButton> driftCompensationButton;
+	ScopedPointer<ToggleButton> adaptiveChunkingButton;
+	ScopedPointer<ToggleButton> eventDrivenWritesButton;
+
+	ScopedPointer<Label> primeLabel;
+	ScopedPointer<ComboBox> primeLengthSelect;
+	ScopedPointer<ComboBox> primeSourceSelect;
+
+	ScopedPointer<Label> writerLabel;
+	ScopedPointer<ComboBox> writerPrioritySelect;
+	ScopedPointer<ComboBox> writerCoreSelect;
+	ScopedPointer<ToggleButton> lockProcessMemoryButton;
+
+	ScopedPointer<Label> digitalCoalescingLabel;
+	ScopedPointer<ComboBox> digitalCoalescingSelect;
+
+	ScopedPointer<Label> routingLabel;
+	ScopedPointer<ComboBox> routingOutputSelect;
+	ScopedPointer<Label> routingExpression;
+
+	ScopedPointer<Label> sourceStreamLabel;
+	ScopedPointer<ComboBox> sourceStreamSelect;
+
 	OwnedArray<ToggleButton> digitalPortButtons;
 
 };
@@ -173,6 +213,12 @@ public:
     /** Called when a combo box selection is changed */
     void comboBoxChanged(ComboBox* comboBoxThatHasChanged);
 
+    /** Locks the sample rate while the AO task runs at the rate it started with */
+    void startAcquisition() override;
+
+    /** Unlocks the sample rate */
+    void stopAcquisition() override;
+
     /** Respond to button presses */
 	void buttonClicked(Button* button) override;
 
@@ -194,6 +240,60 @@ public:
 	bool getPortState(int idx) { return processor->getPortState(idx); };
 	void setPortState(int idx, bool state) { processor->setPortState(idx, state); };
 
+	OverrunPolicy getOverrunPolicy() { return processor->getOverrunPolicy(); };
+	void setOverrunPolicy(OverrunPolicy policy) { processor->setOverrunPolicy(policy); };
+
+	UnderrunPolicy getUnderrunPolicy() { return processor->getUnderrunPolicy(); };
+	void setUnderrunPolicy(UnderrunPolicy policy) { processor->setUnderrunPolicy(policy); };
+
+	int getMaxLatency() { return processor->getMaxLatency(); };
+	void setMaxLatency(int ms) { processor->setMaxLatency(ms); };
+
+	bool getLockBufferMemory() { return processor->getLockBufferMemory(); };
+	void setLockBufferMemory(bool shouldLock) { processor->setLockBufferMemory(shouldLock); };
+
+	bool supportsSinglePointOutput() { return processor->supportsSinglePointOutput(); };
+	AO_OUTPUT_MODE getOutputMode() { return processor->getOutputMode(); };
+	void setOutputMode(AO_OUTPUT_MODE mode) { processor->setOutputMode(mode); };
+
+	bool getAdaptiveChunking() { return processor->getAdaptiveChunking(); };
+	void setAdaptiveChunking(bool shouldAdapt) { processor->setAdaptiveChunking(shouldAdapt); };
+
+	int getWriterPriority() { return processor->getWriterPriority(); };
+	void setWriterPriority(int priority) { processor->setWriterPriority(priority); };
+
+	int getWriterCore() { return processor->getWriterCore(); };
+	void setWriterCore(int core) { processor->setWriterCore(core); };
+
+	bool getLockProcessMemory() { return processor->getLockProcessMemory(); };
+	void setLockProcessMemory(bool shouldLock) { processor->setLockProcessMemory(shouldLock); };
+
+	int getDigitalCoalescingWindow() { return processor->getDigitalCoalescingWindow(); };
+	void setDigitalCoalescingWindow(int ms) { processor->setDigitalCoalescingWindow(ms); };
+
+	bool getEventDrivenWrites() { return processor->getEventDrivenWrites(); };
+	void setEventDrivenWrites(bool shouldUseEvents) { processor->setEventDrivenWrites(shouldUseEvents); };
+
+	int getPrimeLength() { return processor->getPrimeLength(); };
+	void setPrimeLength(int ms) { processor->setPrimeLength(ms); };
+
+	PRIME_SOURCE getPrimeSource() { return processor->getPrimeSource(); };
+	void setPrimeSource(PRIME_SOURCE source) { processor->setPrimeSource(source); };
+
+	bool getDriftCompensation() { return processor->getDriftCompensation(); };
+	void setDriftCompensation(bool shouldCompensate) { processor->setDriftCompensation(shouldCompensate); };
+
+	int getNumAnalogOutputs() { return processor->getTotalAvailableAnalogOutputs(); };
+	String getAnalogRouting(int id) { return processor->getAnalogRouting(id); };
+	bool setAnalogRouting(int id, String expression) { return processor->setAnalogRouting(id, expression); };
+
+	Array<const DataStream*> getDataStreams() { return processor->getDataStreams(); };
+	int getAnalogSourceStream(int id) { return processor->getAnalogSourceStream(id); };
+	void setAnalogSourceStream(int id, int streamIndex) { processor->setAnalogSourceStream(id, streamIndex); };
+
+	AO_DATA_FORMAT getAnalogDataFormat() { return processor->getAnalogDataFormat(); };
+	void setAnalogDataFormat(AO_DATA_FORMAT format) { processor->setAnalogDataFormat(format); };
+
 	void saveCustomParametersToXml(XmlElement*) override;
 	void loadCustomParametersFromXml(XmlElement*) override;
 	
@@ -0,0 +1,259 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Allen Institute for Brain Science and Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "OutputKernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef OUTPUT_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+/* GCC and Clang only emit AVX2 instructions in functions marked for it */
+#if defined(_MSC_VER)
+#define AVX2_FUNCTION
+#else
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+
+size_t convert_to_volts_scalar(const float* source, double* dest, size_t numSamples,
+                               double gain, double offset, double minVolts, double maxVolts)
+{
+    const double zeroVolts = std::min(std::max(0.0, minVolts), maxVolts);
+    size_t clipped = 0;
+
+    for (size_t i = 0; i < numSamples; ++i) {
+        double volts = static_cast<double>(source[i]) * gain + offset;
+
+        if (std::isnan(volts)) {
+            volts = zeroVolts;
+            ++clipped;
+        } else if (volts < minVolts) {
+            volts = minVolts;
+            ++clipped;
+        } else if (volts > maxVolts) {
+            volts = maxVolts;
+            ++clipped;
+        }
+
+        dest[i] = volts;
+    }
+
+    return clipped;
+}
+
+size_t convert_to_dac_codes_scalar(const float* source, int16_t* dest, size_t numSamples,
+                                   double gain, double offset, double minVolts, double maxVolts,
+                                   double codeOffset, double codeSlope)
+{
+    const double zeroVolts = std::min(std::max(0.0, minVolts), maxVolts);
+    size_t clipped = 0;
+
+    for (size_t i = 0; i < numSamples; ++i) {
+        double volts = static_cast<double>(source[i]) * gain + offset;
+
+        if (std::isnan(volts)) {
+            volts = zeroVolts;
+            ++clipped;
+        } else if (volts < minVolts) {
+            volts = minVolts;
+            ++clipped;
+        } else if (volts > maxVolts) {
+            volts = maxVolts;
+            ++clipped;
+        }
+
+        // Saturates like the SIMD versions
+        const double code = std::nearbyint(codeOffset + codeSlope * volts);
+        dest[i] = code >= 32767.0 ? 32767 : code > -32768.0 ? static_cast<int16_t>(code) : -32768;
+    }
+
+    return clipped;
+}
+
+#ifdef OUTPUT_KERNELS_X86
+
+/* Number of set bits in a 4-bit compare mask */
+static const int mask_bit_count[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+size_t convert_to_volts_sse2(const float* source, double* dest, size_t numSamples,
+                             double gain, double offset, double minVolts, double maxVolts)
+{
+    const __m128d g = _mm_set1_pd(gain);
+    const __m128d o = _mm_set1_pd(offset);
+    const __m128d lo = _mm_set1_pd(minVolts);
+    const __m128d hi = _mm_set1_pd(maxVolts);
+    const __m128d zero = _mm_set1_pd(std::min(std::max(0.0, minVolts), maxVolts));
+
+    size_t clipped = 0;
+    size_t i = 0;
+
+    for (; i + 4 <= numSamples; i += 4) {
+        const __m128 in = _mm_loadu_ps(source + i);
+
+        __m128d a = _mm_add_pd(_mm_mul_pd(_mm_cvtps_pd(in), g), o);
+        __m128d b = _mm_add_pd(_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(in, in)), g), o);
+
+        // NaNs count as clipped and are replaced by 0 V
+        const __m128d nanA = _mm_cmpunord_pd(a, a);
+        const __m128d nanB = _mm_cmpunord_pd(b, b);
+
+        const int mask = _mm_movemask_pd(_mm_or_pd(nanA, _mm_or_pd(_mm_cmplt_pd(a, lo), _mm_cmpgt_pd(a, hi))))
+                       | _mm_movemask_pd(_mm_or_pd(nanB, _mm_or_pd(_mm_cmplt_pd(b, lo), _mm_cmpgt_pd(b, hi)))) << 2;
+        clipped += mask_bit_count[mask];
+
+        a = _mm_or_pd(_mm_andnot_pd(nanA, a), _mm_and_pd(nanA, zero));
+        b = _mm_or_pd(_mm_andnot_pd(nanB, b), _mm_and_pd(nanB, zero));
+
+        _mm_storeu_pd(dest + i, _mm_min_pd(hi, _mm_max_pd(lo, a)));
+        _mm_storeu_pd(dest + i + 2, _mm_min_pd(hi, _mm_max_pd(lo, b)));
+    }
+
+    return clipped + convert_to_volts_scalar(source + i, dest + i, numSamples - i, gain, offset, minVolts, maxVolts);
+}
+
+AVX2_FUNCTION
+size_t convert_to_volts_avx2(const float* source, double* dest, size_t numSamples,
+                             double gain, double offset, double minVolts, double maxVolts)
+{
+    const __m256d g = _mm256_set1_pd(gain);
+    const __m256d o = _mm256_set1_pd(offset);
+    const __m256d lo = _mm256_set1_pd(minVolts);
+    const __m256d hi = _mm256_set1_pd(maxVolts);
+    const __m256d zero = _mm256_set1_pd(std::min(std::max(0.0, minVolts), maxVolts));
+
+    size_t clipped = 0;
+    size_t i = 0;
+
+    for (; i + 8 <= numSamples; i += 8) {
+        __m256d a = _mm256_add_pd(_mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(source + i)), g), o);
+        __m256d b = _mm256_add_pd(_mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(source + i + 4)), g), o);
+
+        // NaNs count as clipped and are replaced by 0 V
+        const __m256d nanA = _mm256_cmp_pd(a, a, _CMP_UNORD_Q);
+        const __m256d nanB = _mm256_cmp_pd(b, b, _CMP_UNORD_Q);
+
+        clipped += mask_bit_count[_mm256_movemask_pd(_mm256_or_pd(nanA, _mm256_or_pd(_mm256_cmp_pd(a, lo, _CMP_LT_OQ), _mm256_cmp_pd(a, hi, _CMP_GT_OQ))))];
+        clipped += mask_bit_count[_mm256_movemask_pd(_mm256_or_pd(nanB, _mm256_or_pd(_mm256_cmp_pd(b, lo, _CMP_LT_OQ), _mm256_cmp_pd(b, hi, _CMP_GT_OQ))))];
+
+        a = _mm256_blendv_pd(a, zero, nanA);
+        b = _mm256_blendv_pd(b, zero, nanB);
+
+        _mm256_storeu_pd(dest + i, _mm256_min_pd(hi, _mm256_max_pd(lo, a)));
+        _mm256_storeu_pd(dest + i + 4, _mm256_min_pd(hi, _mm256_max_pd(lo, b)));
+    }
+
+    return clipped + convert_to_volts_scalar(source + i, dest + i, numSamples - i, gain, offset, minVolts, maxVolts);
+}
+
+size_t convert_to_dac_codes_sse2(const float* source, int16_t* dest, size_t numSamples,
+                                 double gain, double offset, double minVolts, double maxVolts,
+                                 double codeOffset, double codeSlope)
+{
+    const __m128d g = _mm_set1_pd(gain);
+    const __m128d o = _mm_set1_pd(offset);
+    const __m128d lo = _mm_set1_pd(minVolts);
+    const __m128d hi = _mm_set1_pd(maxVolts);
+    const __m128d zero = _mm_set1_pd(std::min(std::max(0.0, minVolts), maxVolts));
+    const __m128d c0 = _mm_set1_pd(codeOffset);
+    const __m128d c1 = _mm_set1_pd(codeSlope);
+    const __m128d codeLo = _mm_set1_pd(-32768.0);
+    const __m128d codeHi = _mm_set1_pd(32767.0);
+
+    size_t clipped = 0;
+    size_t i = 0;
+
+    for (; i + 4 <= numSamples; i += 4) {
+        const __m128 in = _mm_loadu_ps(source + i);
+
+        __m128d a = _mm_add_pd(_mm_mul_pd(_mm_cvtps_pd(in), g), o);
+        __m128d b = _mm_add_pd(_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(in, in)), g), o);
+
+        // NaNs count as clipped and are replaced by 0 V
+        const __m128d nanA = _mm_cmpunord_pd(a, a);
+        const __m128d nanB = _mm_cmpunord_pd(b, b);
+
+        const int mask = _mm_movemask_pd(_mm_or_pd(nanA, _mm_or_pd(_mm_cmplt_pd(a, lo), _mm_cmpgt_pd(a, hi))))
+                       | _mm_movemask_pd(_mm_or_pd(nanB, _mm_or_pd(_mm_cmplt_pd(b, lo), _mm_cmpgt_pd(b, hi)))) << 2;
+        clipped += mask_bit_count[mask];
+
+        a = _mm_or_pd(_mm_andnot_pd(nanA, a), _mm_and_pd(nanA, zero));
+        b = _mm_or_pd(_mm_andnot_pd(nanB, b), _mm_and_pd(nanB, zero));
+
+        a = _mm_add_pd(c0, _mm_mul_pd(c1, _mm_min_pd(hi, _mm_max_pd(lo, a))));
+        b = _mm_add_pd(c0, _mm_mul_pd(c1, _mm_min_pd(hi, _mm_max_pd(lo, b))));
+
+        // Round to nearest (the default MXCSR mode) and pack four int32 codes to int16
+        const __m128i codes = _mm_unpacklo_epi64(_mm_cvtpd_epi32(_mm_min_pd(codeHi, _mm_max_pd(codeLo, a))),
+                                                 _mm_cvtpd_epi32(_mm_min_pd(codeHi, _mm_max_pd(codeLo, b))));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dest + i), _mm_packs_epi32(codes, codes));
+    }
+
+    return clipped + convert_to_dac_codes_scalar(source + i, dest + i, numSamples - i, gain, offset, minVolts, maxVolts, codeOffset, codeSlope);
+}
+
+AVX2_FUNCTION
+size_t convert_to_dac_codes_avx2(const float* source, int16_t* dest, size_t numSamples,
+                                 double gain, double offset, double minVolts, double maxVolts,
+                                 double codeOffset, double codeSlope)
+{
+    const __m256d g = _mm256_set1_pd(gain);
+    const __m256d o = _mm256_set1_pd(offset);
+    const __m256d lo = _mm256_set1_pd(minVolts);
+    const __m256d hi = _mm256_set1_pd(maxVolts);
+    const __m256d zero = _mm256_set1_pd(std::min(std::max(0.0, minVolts), maxVolts));
+    const __m256d c0 = _mm256_set1_pd(codeOffset);
+    const __m256d c1 = _mm256_set1_pd(codeSlope);
+    const __m256d codeLo = _mm256_set1_pd(-32768.0);
+    const __m256d codeHi = _mm256_set1_pd(32767.0);
+
+    size_t clipped = 0;
+    size_t i = 0;
+
+    for (; i + 8 <= numSamples; i += 8) {
+        __m256d a = _mm256_add_pd(_mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(source + i)), g), o);
+        __m256d b = _mm256_add_pd(_mm256_mul_pd(_mm256_cvtps_pd(_mm_loadu_ps(source + i + 4)), g), o);
+
+        // NaNs count as clipped and are replaced by 0 V
+        const __m256d nanA = _mm256_cmp_pd(a, a, _CMP_UNORD_Q);
+        const __m256d nanB = _mm256_cmp_pd(b, b, _CMP_UNORD_Q);
+
+        clipped += mask_bit_count[_mm256_movemask_pd(_mm256_or_pd(nanA, _mm256_or_pd(_mm256_cmp_pd(a, lo, _CMP_LT_OQ), _mm256_cmp_pd(a, hi, _CMP_GT_OQ))))];
+        clipped += mask_bit_count[_mm256_movemask_pd(_mm256_or_pd(nanB, _mm256_or_pd(_mm256_cmp_pd(b, lo, _CMP_LT_OQ), _mm256_cmp_pd(b, hi, _CMP_GT_OQ))))];
+
+        a = _mm256_blendv_pd(a, zero, nanA);
+        b = _mm256_blendv_pd(b, zero, nanB);
+
+        a = _mm256_add_pd(c0, _mm256_mul_pd(c1, _mm256_min_pd(hi, _mm256_max_pd(lo, a))));
+        b = _mm256_add_pd(c0, _mm256_mul_pd(c1, _mm256_min_pd(hi, _mm256_max_pd(lo, b))));
+
+        const __m128i codesA = _mm256_cvtpd_epi32(_mm256_min_pd(codeHi, _mm256_max_pd(codeLo, a)));
+        const __m128i codesB = _mm256_cvtpd_epi32(_mm256_min_pd(codeHi, _mm256_max_pd(codeLo, b)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_packs_epi32(codesA, codesB));
+    }
+
+    return clipped + convert_to_dac_codes_scalar(source + i, dest + i, numSamples - i, gain, offset, minVolts, maxVolts, codeOffset, codeSlope);
+}
+
+#endif
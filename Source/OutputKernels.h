@@ -0,0 +1,84 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Allen Institute for Brain Science and Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __OUTPUTKERNELS_H__
+#define __OUTPUTKERNELS_H__
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define OUTPUT_KERNELS_X86 1
+#endif
+
+/* Converts one channel of GUI samples to output volts:
+
+       dest[i] = clamp(source[i] * gain + offset, minVolts, maxVolts)
+
+   and returns the number of samples that had to be clamped. A NaN becomes
+   0 V (clamped to the range) and counts as clamped. Uses AVX2 or SSE2 when
+   the CPU has them (checked once), otherwise convert_to_volts_scalar. */
+size_t convert_to_volts(const float* source, double* dest, size_t numSamples,
+                        double gain, double offset, double minVolts, double maxVolts);
+
+/* Plain C++ version of convert_to_volts; the reference the SIMD versions must match */
+size_t convert_to_volts_scalar(const float* source, double* dest, size_t numSamples,
+                               double gain, double offset, double minVolts, double maxVolts);
+
+/* Converts one channel of GUI samples straight to DAC codes for DAQmxWriteBinaryI16:
+
+       volts   = clamp(source[i] * gain + offset, minVolts, maxVolts)
+       dest[i] = round(codeOffset + codeSlope * volts), saturated to int16
+
+   where codeOffset/codeSlope are the device's AO scaling coefficients for the
+   channel and range. Returns the number of samples clamped to the voltage
+   range; a NaN becomes the code for 0 V and is counted, as in convert_to_volts.
+   Dispatches like convert_to_volts. */
+size_t convert_to_dac_codes(const float* source, int16_t* dest, size_t numSamples,
+                            double gain, double offset, double minVolts, double maxVolts,
+                            double codeOffset, double codeSlope);
+
+/* Plain C++ version of convert_to_dac_codes */
+size_t convert_to_dac_codes_scalar(const float* source, int16_t* dest, size_t numSamples,
+                                   double gain, double offset, double minVolts, double maxVolts,
+                                   double codeOffset, double codeSlope);
+
+#ifdef OUTPUT_KERNELS_X86
+
+/* The SIMD versions behind the dispatchers, exposed so the tests can compare
+   them with the scalar ones. The AVX2 versions must only be called when the
+   CPU supports AVX2. */
+size_t convert_to_volts_sse2(const float* source, double* dest, size_t numSamples,
+                             double gain, double offset, double minVolts, double maxVolts);
+size_t convert_to_volts_avx2(const float* source, double* dest, size_t numSamples,
+                             double gain, double offset, double minVolts, double maxVolts);
+size_t convert_to_dac_codes_sse2(const float* source, int16_t* dest, size_t numSamples,
+                                 double gain, double offset, double minVolts, double maxVolts,
+                                 double codeOffset, double codeSlope);
+size_t convert_to_dac_codes_avx2(const float* source, int16_t* dest, size_t numSamples,
+                                 double gain, double offset, double minVolts, double maxVolts,
+                                 double codeOffset, double codeSlope);
+
+#endif
+
+#endif  // __OUTPUTKERNELS_H__
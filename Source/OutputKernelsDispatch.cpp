@@ -0,0 +1,68 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Allen Institute for Brain Science and Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "OutputKernels.h"
+
+#include <ProcessorHeaders.h>
+
+typedef size_t (*ConvertFunction)(const float*, double*, size_t, double, double, double, double);
+typedef size_t (*CodeFunction)(const float*, int16_t*, size_t, double, double, double, double, double, double);
+
+static ConvertFunction select_convert_function()
+{
+#ifdef OUTPUT_KERNELS_X86
+    if (SystemStats::hasAVX2())
+        return convert_to_volts_avx2;
+    if (SystemStats::hasSSE2())
+        return convert_to_volts_sse2;
+#endif
+    return convert_to_volts_scalar;
+}
+
+static CodeFunction select_code_function()
+{
+#ifdef OUTPUT_KERNELS_X86
+    if (SystemStats::hasAVX2())
+        return convert_to_dac_codes_avx2;
+    if (SystemStats::hasSSE2())
+        return convert_to_dac_codes_sse2;
+#endif
+    return convert_to_dac_codes_scalar;
+}
+
+size_t convert_to_volts(const float* source, double* dest, size_t numSamples,
+                        double gain, double offset, double minVolts, double maxVolts)
+{
+    static const ConvertFunction convert = select_convert_function();
+
+    return convert(source, dest, numSamples, gain, offset, minVolts, maxVolts);
+}
+
+size_t convert_to_dac_codes(const float* source, int16_t* dest, size_t numSamples,
+                            double gain, double offset, double minVolts, double maxVolts,
+                            double codeOffset, double codeSlope)
+{
+    static const CodeFunction convert = select_code_function();
+
+    return convert(source, dest, numSamples, gain, offset, minVolts, maxVolts, codeOffset, codeSlope);
+}
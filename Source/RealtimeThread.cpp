@@ -0,0 +1,131 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Allen Institute for Brain Science and Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <alloca.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+#include "RealtimeThread.h"
+
+#include <mutex>
+
+/* Instances that asked for the process to stay locked; munlockall() waits for the last one */
+static std::mutex processLockMutex;
+static int processLockCount = 0;
+
+bool set_thread_realtime_priority(int priority)
+{
+#ifdef _WIN32
+	const int level = priority > 66 ? THREAD_PRIORITY_TIME_CRITICAL : priority > 33 ? THREAD_PRIORITY_HIGHEST : THREAD_PRIORITY_ABOVE_NORMAL;
+
+	return SetThreadPriority(GetCurrentThread(), level) != 0;
+#else
+	const int minPriority = sched_get_priority_min(SCHED_FIFO);
+	const int maxPriority = sched_get_priority_max(SCHED_FIFO);
+
+	sched_param param;
+	param.sched_priority = priority < minPriority ? minPriority : priority > maxPriority ? maxPriority : priority;
+
+	return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+#endif
+}
+
+bool set_thread_cpu_core(int core)
+{
+	if (core < 0)
+		return false;
+
+#if defined(_WIN32)
+	if (core >= int(sizeof(DWORD_PTR) * 8))
+		return false;
+
+	return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << core) != 0;
+#elif defined(__linux__)
+	if (core >= CPU_SETSIZE)
+		return false;
+
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(core, &cpus);
+
+	return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#else
+	// macOS only takes affinity hints between threads, not cores
+	return false;
+#endif
+}
+
+bool lock_process_memory()
+{
+#ifdef _WIN32
+	// No process-wide equivalent; buffers are locked individually (lock_memory_pages)
+	return false;
+#else
+	std::lock_guard<std::mutex> lock(processLockMutex);
+
+	// Pages mapped since the first caller locked are covered too
+	if (mlockall(MCL_CURRENT) != 0 && processLockCount == 0)
+		return false;
+
+	++processLockCount;
+	return true;
+#endif
+}
+
+bool unlock_process_memory()
+{
+#ifdef _WIN32
+	return false;
+#else
+	std::lock_guard<std::mutex> lock(processLockMutex);
+
+	if (processLockCount == 0 || --processLockCount > 0)
+		return false;
+
+	munlockall();
+	return true;
+#endif
+}
+
+bool lock_thread_stack(size_t numBytes)
+{
+#ifdef _WIN32
+	return false;
+#else
+	// The pages stay mapped (and locked) after this frame returns, ready for deeper calls later
+	volatile char* stack = static_cast<volatile char*>(alloca(numBytes));
+	for (size_t i = 0; i < numBytes; i += 4096)
+		stack[i] = 0;
+
+	return mlock(const_cast<char*>(stack), numBytes) == 0;
+#endif
+}
@@ -0,0 +1,58 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Allen Institute for Brain Science and Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __REALTIMETHREAD_H__
+#define __REALTIMETHREAD_H__
+
+#include <cstddef>
+
+/*
+    Scheduling helpers for the thread that calls them. Each returns false
+    if the OS refused (usually for lack of privileges, e.g. RLIMIT_RTPRIO,
+    CAP_SYS_NICE or RLIMIT_MEMLOCK on Linux) or doesn't support it; the
+    thread keeps running as before either way.
+*/
+
+/* SCHED_FIFO at priority (1-99) on POSIX systems. Windows has only a few
+   thread levels: 1-33 is above normal, 34-66 highest, 67-99 time-critical. */
+bool set_thread_realtime_priority(int priority);
+
+/* Restricts the calling thread to one CPU core (0-based); not available on macOS */
+bool set_thread_cpu_core(int core);
+
+/* Pins the pages the process has mapped now in RAM. Later allocations stay
+   pageable: locking them too (MCL_FUTURE) would make allocations anywhere in
+   the GUI fail or stall once RLIMIT_MEMLOCK is reached. The lock is shared by
+   every caller in the process; each successful call takes one reference. */
+bool lock_process_memory();
+
+/* Drops a reference taken by lock_process_memory(). The last one releases
+   every locked page of the process, including ones locked individually with
+   lock_memory_pages, and returns true so they can be locked again. */
+bool unlock_process_memory();
+
+/* Faults in and pins the top numBytes of the calling thread's stack, which
+   lock_process_memory() doesn't cover for threads started after it */
+bool lock_thread_stack(size_t numBytes);
+
+#endif  // __REALTIMETHREAD_H__
@@ -0,0 +1,265 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Allen Institute for Brain Science and Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include "Resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/* SSE is part of the x86-64 baseline, so it needs no runtime check */
+#if defined(__x86_64__) || defined(_M_X64)
+#define RESAMPLER_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+const double pi = 3.14159265358979323846;
+
+/* Filter length for the plain (non-decimating) case; it grows as the cutoff drops */
+const int base_taps = 32;
+const int max_taps = 256;
+
+/* Fraction of the lower Nyquist rate the passband extends to */
+const double cutoff_fraction = 0.9;
+
+long long gcd(long long a, long long b)
+{
+    while (b != 0) {
+        long long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/* Sum of taps[i] * samples[i]; numTaps is a multiple of 8 */
+inline float dot(const float* taps, const float* samples, int numTaps)
+{
+#ifdef RESAMPLER_SSE
+    __m128 sum0 = _mm_setzero_ps();
+    __m128 sum1 = _mm_setzero_ps();
+
+    for (int i = 0; i < numTaps; i += 8) {
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(taps + i), _mm_loadu_ps(samples + i)));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(taps + i + 4), _mm_loadu_ps(samples + i + 4)));
+    }
+
+    __m128 sum = _mm_add_ps(sum0, sum1);
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+#else
+    float sum = 0.0f;
+    for (int i = 0; i < numTaps; ++i)
+        sum += taps[i] * samples[i];
+    return sum;
+#endif
+}
+
+} // namespace
+
+Resampler::Resampler(double inputRate, double outputRate, int numChannels, int maxBlockSize)
+    : input_rate(inputRate),
+      output_rate(outputRate),
+      num_channels(std::max(numChannels, 1)),
+      max_block_size(std::max(maxBlockSize, 1))
+{
+    const double ratio = output_rate / input_rate;
+
+    // Cutoff in cycles per input sample, below both Nyquist rates
+    const double cutoff = 0.5 * cutoff_fraction * std::min(1.0, ratio);
+
+    int taps = static_cast<int>(std::ceil(base_taps / std::min(1.0, ratio)));
+    taps = std::min(max_taps, (taps + 7) / 8 * 8);
+    num_taps = taps;
+
+    // Rates are integral in practice (Hz); below that resolution fall back to interpolation
+    if (input_rate == std::floor(input_rate) && output_rate == std::floor(output_rate)) {
+        long long in = static_cast<long long>(input_rate);
+        long long out = static_cast<long long>(output_rate);
+        long long divisor = gcd(in, out);
+
+        if (divisor > 0 && out / divisor <= max_exact_phases) {
+            up = static_cast<int>(out / divisor);
+            down = static_cast<int>(in / divisor);
+            exact_available = true;
+            build_bank(exact_bank, up, up, cutoff);
+        }
+    }
+
+    exact = exact_available;
+    step = input_rate / output_rate;
+
+    // One extra phase so the interpolation never reads past the end
+    build_bank(interpolated_bank, interpolated_phases + 1, interpolated_phases, cutoff);
+
+    history_stride = num_taps + max_block_size;
+    history.assign(static_cast<size_t>(history_stride) * num_channels, 0.0f);
+
+    // Prime with zeros so the first output lines up with the first input sample
+    num_buffered = num_taps / 2 - 1;
+    index = num_taps / 2 - 1;
+}
+
+void Resampler::build_bank(std::vector<float>& bank, int numPhases, int phasesPerSample, double cutoff)
+{
+    const int half = num_taps / 2;
+
+    bank.assign(static_cast<size_t>(numPhases) * num_taps, 0.0f);
+
+    for (int p = 0; p < numPhases; ++p) {
+        const double fraction = static_cast<double>(p) / phasesPerSample;
+        float* taps = bank.data() + static_cast<size_t>(p) * num_taps;
+        double sum = 0.0;
+
+        for (int k = 0; k < num_taps; ++k) {
+            // Time of tap k relative to the output position, in input samples
+            const double t = (k - (half - 1)) - fraction;
+            const double x = 2.0 * cutoff * t;
+            const double sinc = (x == 0.0) ? 1.0 : std::sin(pi * x) / (pi * x);
+            const double w = (t + half) / num_taps;
+            const double window = 0.42 - 0.5 * std::cos(2.0 * pi * w) + 0.08 * std::cos(4.0 * pi * w);
+
+            const double value = sinc * window;
+            taps[k] = static_cast<float>(value);
+            sum += value;
+        }
+
+        // Unity DC gain for every phase
+        for (int k = 0; k < num_taps; ++k)
+            taps[k] = static_cast<float>(taps[k] / sum);
+    }
+}
+
+int Resampler::get_max_output(int numInput) const
+{
+    return static_cast<int>(std::ceil(numInput * (output_rate / input_rate) * ratio_adjust)) + 2;
+}
+
+void Resampler::set_ratio_adjust(double adjust)
+{
+    if (adjust <= 0.0)
+        return;
+
+    if (exact && adjust != 1.0) {
+        fraction = static_cast<double>(phase) / up;
+        exact = false;
+    } else if (!exact && adjust == 1.0 && exact_available) {
+        phase = static_cast<int>(std::lround(fraction * up));
+        if (phase >= up) {
+            phase -= up;
+            ++index;
+        }
+        exact = true;
+    }
+
+    ratio_adjust = adjust;
+    step = input_rate / (output_rate * adjust);
+}
+
+int Resampler::process(const float* const* input, int numInput, float* const* output, int maxOutput)
+{
+    int produced = 0;
+    int consumed = 0;
+
+    while (consumed < numInput) {
+        const int chunk = std::min(numInput - consumed, max_block_size);
+
+        for (int ch = 0; ch < num_channels; ++ch) {
+            std::memcpy(history.data() + static_cast<size_t>(ch) * history_stride + num_buffered,
+                        input[ch] + consumed, sizeof(float) * chunk);
+        }
+
+        num_buffered += chunk;
+        consumed += chunk;
+
+        produced += convert(maxOutput - produced, output, produced);
+    }
+
+    return produced;
+}
+
+int Resampler::convert(int numOutputMax, float* const* output, int outputOffset)
+{
+    const int half = num_taps / 2;
+    int produced = 0;
+
+    // An output at index needs input samples index - half + 1 ... index + half
+    while (index + half < num_buffered) {
+        const int start = index - half + 1;
+
+        if (produced < numOutputMax) {
+            if (exact) {
+                const float* taps = exact_bank.data() + static_cast<size_t>(phase) * num_taps;
+
+                for (int ch = 0; ch < num_channels; ++ch) {
+                    const float* samples = history.data() + static_cast<size_t>(ch) * history_stride + start;
+                    output[ch][outputOffset + produced] = dot(taps, samples, num_taps);
+                }
+            } else {
+                const double position = fraction * interpolated_phases;
+                const int p = std::min(static_cast<int>(position), interpolated_phases - 1);
+                const float blend = static_cast<float>(position - p);
+                const float* taps0 = interpolated_bank.data() + static_cast<size_t>(p) * num_taps;
+                const float* taps1 = taps0 + num_taps;
+
+                for (int ch = 0; ch < num_channels; ++ch) {
+                    const float* samples = history.data() + static_cast<size_t>(ch) * history_stride + start;
+                    const float a = dot(taps0, samples, num_taps);
+                    const float b = dot(taps1, samples, num_taps);
+                    output[ch][outputOffset + produced] = a + (b - a) * blend;
+                }
+            }
+
+            ++produced;
+        }
+
+        if (exact) {
+            phase += down;
+            index += phase / up;
+            phase %= up;
+        } else {
+            fraction += step;
+            const double whole = std::floor(fraction);
+            index += static_cast<int>(whole);
+            fraction -= whole;
+        }
+    }
+
+    // Drop the samples no future output can reach
+    const int shift = std::min(std::max(index - half + 1, 0), num_buffered);
+
+    if (shift > 0) {
+        for (int ch = 0; ch < num_channels; ++ch) {
+            float* row = history.data() + static_cast<size_t>(ch) * history_stride;
+            std::memmove(row, row + shift, sizeof(float) * (num_buffered - shift));
+        }
+
+        num_buffered -= shift;
+        index -= shift;
+    }
+
+    return produced;
+}
@@ -0,0 +1,120 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Allen Institute for Brain Science and Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef __RESAMPLER_H__
+#define __RESAMPLER_H__
+
+#include <cstddef>
+#include <vector>
+
+/*
+    Streaming multi-channel sample-rate converter based on a windowed-sinc
+    polyphase filter bank.
+
+    Each output sample is the dot product of one filter phase with the
+    input samples around its position in time. The position advances by
+    input_rate / output_rate input samples per output sample.
+
+    When that step is a ratio of small integers (output/input = L/M with
+    L <= max_exact_phases, which covers all integer up- and down-sampling
+    ratios) the bank holds exactly the L phases that occur and positions are
+    tracked with integer arithmetic: no phase is ever interpolated and the
+    output does not drift. Any other ratio, or any ratio trimmed with
+    set_ratio_adjust(), uses a bank of interpolated_phases phases and
+    blends the two phases nearest each output position.
+
+    The filter cuts off just below the lower of the two Nyquist rates, so
+    downsampling is anti-aliased. Output frame k sits at input position
+    k / ratio; it comes out once get_latency() input samples past that
+    position have arrived, so the filter holds frames back without moving
+    them in time.
+
+    process() must only be called from one thread. It never allocates.
+*/
+class Resampler {
+public:
+    /* maxBlockSize is the most input frames process() handles at once; longer blocks are split */
+    Resampler(double inputRate, double outputRate, int numChannels, int maxBlockSize);
+
+    /* Consumes numInput frames (one pointer per channel) and writes up to
+       maxOutput frames (one pointer per channel). Returns the number of
+       frames written; input that would produce more than maxOutput frames
+       is still consumed, and its output dropped. */
+    int process(const float* const* input, int numInput, float* const* output, int maxOutput);
+
+    /* Upper bound on the frames process() can return for numInput input frames */
+    int get_max_output(int numInput) const;
+
+    /* Trims the conversion ratio (output frames per input frame) by a factor
+       close to 1, e.g. to track clock drift. Anything other than 1 switches
+       to the interpolated phase bank. */
+    void set_ratio_adjust(double adjust);
+    double get_ratio_adjust() const { return ratio_adjust; }
+
+    /* Nominal output frames per input frame */
+    double get_ratio() const { return output_rate / input_rate; }
+
+    /* Input samples needed past an output frame's position before it is produced */
+    int get_latency() const { return num_taps / 2; }
+
+    int get_num_channels() const { return num_channels; }
+
+    /* True when the exact (integer-phase) path is in use */
+    bool uses_exact_phases() const { return exact; }
+
+    static const int max_exact_phases = 256;
+    static const int interpolated_phases = 256;
+
+private:
+    int convert(int numOutputMax, float* const* output, int outputOffset);
+    void build_bank(std::vector<float>& bank, int numPhases, int phasesPerSample, double cutoff);
+
+    double input_rate;
+    double output_rate;
+    int num_channels;
+    int max_block_size;
+
+    int num_taps;                   // per phase; a multiple of 8
+
+    // Exact path: output/input = up / down; position is index + phase / up
+    bool exact = false;
+    bool exact_available = false;
+    int up = 1;
+    int down = 1;
+    int phase = 0;
+    std::vector<float> exact_bank;
+
+    // Interpolated path: position is index + fraction
+    double step = 1.0;
+    double fraction = 0.0;
+    double ratio_adjust = 1.0;
+    std::vector<float> interpolated_bank;
+
+    // Input history, one row of (num_taps + max_block_size) samples per channel
+    std::vector<float> history;
+    int history_stride;
+    int num_buffered;               // samples in each row
+    int index;                      // input sample at or before the next output position
+};
+
+#endif  // __RESAMPLER_H__
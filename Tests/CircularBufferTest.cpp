@@ -0,0 +1,364 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Allen Institute for Brain Science and Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/* Checks the SPSC ring: wrap-around and split regions in both layouts, each
+   overrun and underrun policy, and two threads streaming through it. Every
+   frame holds its own free-running position on channel 0 and its negation
+   on channel 1, so any frame can be checked against where it came from. */
+
+#include "../Source/CircularBuffer.h"
+
+#include <atomic>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(condition, ...)                                  \
+    do {                                                       \
+        if (!(condition)) {                                    \
+            std::printf("FAILED %s:%d: ", __FILE__, __LINE__); \
+            std::printf(__VA_ARGS__);                          \
+            std::printf("\n");                                 \
+            ++failures;                                        \
+        }                                                      \
+    } while (0)
+
+typedef CircularBuffer<int> Buffer;
+
+static const char* layout_name(BufferLayout layout)
+{
+    return layout == BufferLayout::PLANAR ? "planar" : "interleaved";
+}
+
+/* numFrames interleaved frames starting at position first */
+static std::vector<int> make_frames(int first, int numFrames)
+{
+    std::vector<int> frames;
+    for (int i = 0; i < numFrames; i++) {
+        frames.push_back(first + i);
+        frames.push_back(-(first + i));
+    }
+    return frames;
+}
+
+/* Checks the first numFrames frames of a read of readFrames (numFrames if 0), in the buffer's
+   own layout, against positions first, first + 1, ... */
+static bool frames_match(const std::vector<int>& data, BufferLayout layout, int first, int numFrames, int readFrames = 0)
+{
+    const int channelStride = readFrames > 0 ? readFrames : numFrames;
+
+    for (int i = 0; i < numFrames; i++) {
+        const int a = layout == BufferLayout::PLANAR ? data[i] : data[i * 2];
+        const int b = layout == BufferLayout::PLANAR ? data[channelStride + i] : data[i * 2 + 1];
+        if (a != first + i || b != -(first + i))
+            return false;
+    }
+    return true;
+}
+
+static bool span_matches(const Buffer::Span& span, int first)
+{
+    for (size_t i = 0; i < span.size; i++)
+        if (span.get_channel(0)[i * span.frame_stride] != int(first + i) || span.get_channel(1)[i * span.frame_stride] != -int(first + i))
+            return false;
+    return true;
+}
+
+static void test_wrap(BufferLayout layout)
+{
+    const char* name = layout_name(layout);
+    Buffer buffer(5, 2, layout);
+    CHECK(buffer.get_capacity() == 8, "%s: capacity %zu, expected 8", name, buffer.get_capacity());
+
+    std::vector<int> data(2 * 8);
+
+    // Move the indices most of the way round
+    std::vector<int> frames = make_frames(0, 6);
+    CHECK(buffer.write(frames.data(), 6) == 6, "%s: first write", name);
+    CHECK(buffer.read(data.data(), 6, 0), "%s: first read", name);
+    CHECK(frames_match(data, layout, 0, 6), "%s: first read contents", name);
+
+    // This write wraps: 2 frames at the end of storage, 4 at the start
+    frames = make_frames(6, 6);
+    Buffer::Region region = buffer.reserve(6);
+    CHECK(region.first.size == 2 && region.second.size == 4 && region.position == 6,
+          "%s: reserve split %zu + %zu at %zu", name, region.first.size, region.second.size, region.position);
+    buffer.commit(0);
+
+    CHECK(buffer.write(frames.data(), 6) == 6, "%s: wrapping write", name);
+    CHECK(buffer.get_write_index() == 4 && buffer.get_write_position() == 12, "%s: write index after wrap", name);
+
+    region = buffer.peek(8);
+    CHECK(region.size() == 6 && region.first.size == 2 && region.second.size == 4, "%s: peek split", name);
+    CHECK(span_matches(region.first, 6) && span_matches(region.second, 8), "%s: peeked contents", name);
+    CHECK(buffer.release(1), "%s: partial release", name);
+    CHECK(buffer.get_num_available() == 5, "%s: available after partial release", name);
+
+    CHECK(buffer.read(data.data(), 5, 0), "%s: wrapping read", name);
+    CHECK(frames_match(data, layout, 7, 5), "%s: wrapping read contents", name);
+
+    // Channel-by-channel writes land in the same places
+    std::vector<int> channel0, channel1;
+    for (int i = 12; i < 19; i++) {
+        channel0.push_back(i);
+        channel1.push_back(-i);
+    }
+    const int* channels[] = { channel0.data(), channel1.data() };
+    CHECK(buffer.write(channels, 7) == 7, "%s: per-channel write", name);
+    CHECK(buffer.read(data.data(), 7, 0), "%s: per-channel read", name);
+    CHECK(frames_match(data, layout, 12, 7), "%s: per-channel contents", name);
+
+    CHECK(buffer.get_num_overruns() == 0 && buffer.get_num_underruns() == 0, "%s: no overruns or underruns", name);
+}
+
+static void test_drop_oldest()
+{
+    Buffer buffer(8, 2, BufferLayout::PLANAR);
+    buffer.set_overrun_policy(OverrunPolicy::DROP_OLDEST);
+
+    std::vector<int> frames = make_frames(0, 6);
+    buffer.write(frames.data(), 6);
+
+    // 6 more only fit by dropping the 4 oldest
+    frames = make_frames(6, 6);
+    CHECK(buffer.write(frames.data(), 6) == 6, "drop oldest: write");
+    CHECK(buffer.get_num_overruns() == 1 && buffer.get_num_dropped_frames() == 4, "drop oldest: %llu overruns, %llu dropped",
+          (unsigned long long)buffer.get_num_overruns(), (unsigned long long)buffer.get_num_dropped_frames());
+    CHECK(buffer.get_read_position() == 4, "drop oldest: read position %zu", buffer.get_read_position());
+
+    std::vector<int> data(2 * 8);
+    CHECK(buffer.read(data.data(), 8, 0) && frames_match(data, BufferLayout::PLANAR, 4, 8), "drop oldest: survivors");
+
+    // More than the capacity in one go keeps only the newest frames
+    frames = make_frames(0, 20);
+    CHECK(buffer.write(frames.data(), 20) == 8, "drop oldest: oversized write");
+    CHECK(buffer.read(data.data(), 8, 0) && frames_match(data, BufferLayout::PLANAR, 12, 8), "drop oldest: oversized survivors");
+
+    // A peeked region the producer overwrites can't be released
+    frames = make_frames(20, 8);
+    buffer.write(frames.data(), 8);
+    Buffer::Region region = buffer.peek(8);
+    frames = make_frames(28, 3);
+    buffer.write(frames.data(), 3);
+    CHECK(!buffer.release(region.size()), "drop oldest: release of an overwritten region");
+    CHECK(buffer.get_read_position() == 23, "drop oldest: read position %zu after failed release", buffer.get_read_position());
+
+    region = buffer.peek(8);
+    CHECK(region.position == 23 && span_matches(region.first, 23) && span_matches(region.second, 23 + int(region.first.size)),
+          "drop oldest: peek after failed release");
+    CHECK(buffer.release(region.size()), "drop oldest: release after re-peek");
+}
+
+static void test_drop_newest()
+{
+    Buffer buffer(8, 2);
+    buffer.set_overrun_policy(OverrunPolicy::DROP_NEWEST);
+
+    std::vector<int> frames = make_frames(0, 6);
+    buffer.write(frames.data(), 6);
+
+    frames = make_frames(6, 6);
+    CHECK(buffer.write(frames.data(), 6) == 2, "drop newest: only the free space is stored");
+    CHECK(buffer.get_num_overruns() == 1 && buffer.get_num_dropped_frames() == 4, "drop newest: counters");
+
+    std::vector<int> data(2 * 8);
+    CHECK(buffer.read(data.data(), 8, 0) && frames_match(data, BufferLayout::INTERLEAVED, 0, 8), "drop newest: contents");
+}
+
+static void test_block()
+{
+    Buffer buffer(8, 2);
+    buffer.set_overrun_policy(OverrunPolicy::BLOCK, 1);
+
+    std::vector<int> frames = make_frames(0, 6);
+    buffer.write(frames.data(), 6);
+
+    // Nobody reads: after the timeout only what fits is stored
+    frames = make_frames(6, 6);
+    CHECK(buffer.write(frames.data(), 6) == 2, "block: timeout stores what fits");
+    CHECK(buffer.get_num_overruns() == 1 && buffer.get_num_dropped_frames() == 4, "block: counters");
+
+    // A consumer that frees space in time lets everything through
+    buffer.set_overrun_policy(OverrunPolicy::BLOCK, 2000);
+    std::thread consumer([&buffer]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        std::vector<int> data(2 * 8);
+        buffer.read(data.data(), 8, 0);
+    });
+    frames = make_frames(8, 6);
+    CHECK(buffer.write(frames.data(), 6) == 6, "block: waits for the consumer");
+    consumer.join();
+    CHECK(buffer.get_num_overruns() == 1, "block: no overrun when the consumer keeps up");
+}
+
+static void test_underrun_policies()
+{
+    std::vector<int> data(2 * 5);
+
+    for (UnderrunPolicy policy : { UnderrunPolicy::ZERO_FILL, UnderrunPolicy::HOLD_LAST }) {
+        for (BufferLayout layout : { BufferLayout::INTERLEAVED, BufferLayout::PLANAR }) {
+            const char* name = policy == UnderrunPolicy::ZERO_FILL ? "zero fill" : "hold last";
+            Buffer buffer(8, 2, layout);
+            buffer.set_underrun_policy(policy);
+
+            std::vector<int> frames = make_frames(1, 3);
+            buffer.write(frames.data(), 3);
+
+            CHECK(buffer.read(data.data(), 5, 0), "%s %s: read", name, layout_name(layout));
+            CHECK(frames_match(data, layout, 1, 3, 5), "%s %s: frames that were there", name, layout_name(layout));
+
+            const int expected0 = policy == UnderrunPolicy::ZERO_FILL ? 0 : 3;
+            for (int i = 3; i < 5; i++) {
+                const int a = layout == BufferLayout::PLANAR ? data[i] : data[i * 2];
+                const int b = layout == BufferLayout::PLANAR ? data[5 + i] : data[i * 2 + 1];
+                CHECK(a == expected0 && b == -expected0, "%s %s: padding [%d] = %d, %d", name, layout_name(layout), i, a, b);
+            }
+
+            CHECK(buffer.get_num_underruns() == 1 && buffer.get_num_padded_frames() == 2, "%s %s: counters", name, layout_name(layout));
+            CHECK(buffer.get_num_available() == 0, "%s %s: everything consumed", name, layout_name(layout));
+
+            // With nothing there at all, hold last repeats the last frame ever read
+            CHECK(buffer.read(data.data(), 2, 0), "%s %s: empty read", name, layout_name(layout));
+            CHECK(data[0] == expected0, "%s %s: empty read pads with %d", name, layout_name(layout), data[0]);
+        }
+    }
+
+    Buffer buffer(8, 2);
+    buffer.set_underrun_policy(UnderrunPolicy::WAIT);
+    std::vector<int> frames = make_frames(0, 3);
+    buffer.write(frames.data(), 3);
+
+    CHECK(!buffer.read(data.data(), 5, 1), "wait: short read fails");
+    CHECK(buffer.get_num_available() == 3 && buffer.get_num_underruns() == 1 && buffer.get_num_padded_frames() == 0,
+          "wait: nothing consumed or padded");
+    CHECK(buffer.read(data.data(), 3, 0) && frames_match(data, BufferLayout::INTERLEAVED, 0, 3), "wait: full read");
+
+    buffer.note_underrun(4);
+    CHECK(buffer.get_num_underruns() == 2 && buffer.get_num_padded_frames() == 4, "note_underrun counters");
+
+    buffer.reset_counters();
+    CHECK(buffer.get_num_underruns() == 0 && buffer.get_num_padded_frames() == 0, "reset_counters");
+}
+
+/* The producer writes random-sized blocks of consecutive frames while the
+   consumer alternates between read() and peek()/release(). With DROP_NEWEST
+   the producer retries what didn't fit, so the consumer must see every
+   frame in order; with DROP_OLDEST it may miss frames, but every frame it
+   manages to release must still be the one at its position. */
+static void test_two_threads(OverrunPolicy overrunPolicy, BufferLayout layout)
+{
+    const char* name = overrunPolicy == OverrunPolicy::DROP_OLDEST ? "stress drop oldest" : "stress drop newest";
+    const int totalFrames = 2000000;
+
+    Buffer buffer(64, 2, layout);
+    buffer.set_overrun_policy(overrunPolicy);
+    buffer.set_underrun_policy(UnderrunPolicy::WAIT);
+
+    std::atomic<bool> stop { false };
+
+    std::thread producer([&buffer, &stop, overrunPolicy, totalFrames]() {
+        std::mt19937 random(1);
+        std::uniform_int_distribution<int> blockSize(1, 48);
+        int next = 0;
+
+        while (next < totalFrames && !stop) {
+            const int count = std::min(blockSize(random), totalFrames - next);
+            std::vector<int> frames = make_frames(next, count);
+
+            if (overrunPolicy == OverrunPolicy::DROP_OLDEST) {
+                buffer.write(frames.data(), count);
+                next += count;
+            } else {
+                next += int(buffer.write(frames.data(), count));
+                if (buffer.get_free_space() == 0)
+                    std::this_thread::yield();
+            }
+        }
+    });
+
+    std::mt19937 random(2);
+    std::uniform_int_distribution<int> chunkSize(1, 40);
+    std::vector<int> data(2 * 40);
+
+    int expected = 0;
+    int numFailedReleases = 0;
+    bool ok = true;
+
+    while (ok && expected < totalFrames) {
+        const int count = std::min(chunkSize(random), totalFrames - expected);
+
+        if (overrunPolicy == OverrunPolicy::DROP_NEWEST && (count & 1)) {
+            if (!buffer.read(data.data(), count, 100))
+                continue;
+            ok = frames_match(data, layout, expected, count);
+            CHECK(ok, "%s %s: read() out of sequence at %d", name, layout_name(layout), expected);
+            expected += count;
+        } else {
+            Buffer::Region region = buffer.peek(count);
+            if (region.size() == 0) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            const int first = int(region.position);
+            const bool contents = span_matches(region.first, first) && span_matches(region.second, first + int(region.first.size));
+
+            if (!buffer.release(region.size())) {
+                numFailedReleases++;
+                continue;
+            }
+
+            ok = contents && (overrunPolicy == OverrunPolicy::DROP_OLDEST ? first >= expected : first == expected);
+            CHECK(ok, "%s %s: released frames at %d, expected %d", name, layout_name(layout), first, expected);
+            expected = first + int(region.size());
+        }
+    }
+
+    stop = true;
+    producer.join();
+
+    if (overrunPolicy == OverrunPolicy::DROP_NEWEST)
+        CHECK(numFailedReleases == 0, "%s %s: %d failed releases without DROP_OLDEST", name, layout_name(layout), numFailedReleases);
+}
+
+int main()
+{
+    test_wrap(BufferLayout::INTERLEAVED);
+    test_wrap(BufferLayout::PLANAR);
+    test_drop_oldest();
+    test_drop_newest();
+    test_block();
+    test_underrun_policies();
+
+    for (OverrunPolicy policy : { OverrunPolicy::DROP_NEWEST, OverrunPolicy::DROP_OLDEST })
+        for (BufferLayout layout : { BufferLayout::INTERLEAVED, BufferLayout::PLANAR })
+            test_two_threads(policy, layout);
+
+    if (failures == 0)
+        std::printf("All circular buffer tests passed\n");
+
+    return failures == 0 ? 0 : 1;
+}
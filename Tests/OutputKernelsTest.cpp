@@ -0,0 +1,215 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Allen Institute for Brain Science and Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/* Checks the SIMD output kernels against the scalar reference: every block
+   length up to a few vector widths (so all tail lengths are hit), samples on
+   and beyond the clip bounds, NaN/Inf input, and int16 code saturation. */
+
+#include "../Source/OutputKernels.h"
+
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static int failures = 0;
+
+#define CHECK(condition, ...)                                  \
+    do {                                                       \
+        if (!(condition)) {                                    \
+            std::printf("FAILED %s:%d: ", __FILE__, __LINE__); \
+            std::printf(__VA_ARGS__);                          \
+            std::printf("\n");                                 \
+            ++failures;                                        \
+        }                                                      \
+    } while (0)
+
+typedef size_t (*ConvertFunction)(const float*, double*, size_t, double, double, double, double);
+typedef size_t (*CodeFunction)(const float*, int16_t*, size_t, double, double, double, double, double, double);
+
+struct Kernels
+{
+    const char* name;
+    ConvertFunction volts;
+    CodeFunction codes;
+};
+
+struct Scaling
+{
+    double gain;
+    double offset;
+    double minVolts;
+    double maxVolts;
+    double codeOffset;
+    double codeSlope;
+};
+
+static bool cpu_has_avx2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    const bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    return osSavesYmm && (info[1] & (1 << 5));
+#elif defined(OUTPUT_KERNELS_X86)
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+/* Samples that exercise the clip bounds, the code range and non-finite input */
+static std::vector<float> make_samples(size_t count, std::mt19937& random)
+{
+    static const float special[] = {
+        0.0f, -0.0f, 1.0f, -1.0f, 10.0f, -10.0f, 10.5f, -10.5f, 1.0e6f, -1.0e6f,
+        std::numeric_limits<float>::quiet_NaN(),
+        std::numeric_limits<float>::infinity(),
+        -std::numeric_limits<float>::infinity(),
+        std::numeric_limits<float>::max(),
+        std::numeric_limits<float>::lowest(),
+        std::numeric_limits<float>::denorm_min()
+    };
+    const size_t numSpecial = sizeof(special) / sizeof(special[0]);
+
+    std::uniform_real_distribution<float> value(-20.0f, 20.0f);
+    std::uniform_int_distribution<int> pick(0, 3);
+
+    std::vector<float> samples(count);
+    for (size_t i = 0; i < count; ++i)
+        samples[i] = pick(random) == 0 ? special[random() % numSpecial] : value(random);
+    return samples;
+}
+
+static void compare(const Kernels& kernels, const Scaling& s, const std::vector<float>& samples, size_t count)
+{
+    // Guard values after the block catch kernels that write past numSamples
+    std::vector<double> expectedVolts(count + 1, 12345.0), actualVolts(count + 1, 12345.0);
+    std::vector<int16_t> expectedCodes(count + 1, 12345), actualCodes(count + 1, 12345);
+
+    const size_t expectedVoltsClipped = convert_to_volts_scalar(samples.data(), expectedVolts.data(), count,
+                                                                s.gain, s.offset, s.minVolts, s.maxVolts);
+    const size_t actualVoltsClipped = kernels.volts(samples.data(), actualVolts.data(), count,
+                                                    s.gain, s.offset, s.minVolts, s.maxVolts);
+
+    CHECK(expectedVoltsClipped == actualVoltsClipped, "%s volts: %zu samples, clipped %zu, expected %zu",
+          kernels.name, count, actualVoltsClipped, expectedVoltsClipped);
+
+    for (size_t i = 0; i <= count; ++i) {
+        CHECK(expectedVolts[i] == actualVolts[i], "%s volts: %zu samples, [%zu] = %g, expected %g",
+              kernels.name, count, i, actualVolts[i], expectedVolts[i]);
+
+        if (i < count)
+            CHECK(actualVolts[i] >= s.minVolts && actualVolts[i] <= s.maxVolts, "%s volts: [%zu] = %g outside [%g, %g]",
+                  kernels.name, i, actualVolts[i], s.minVolts, s.maxVolts);
+    }
+
+    const size_t expectedCodesClipped = convert_to_dac_codes_scalar(samples.data(), expectedCodes.data(), count,
+                                                                    s.gain, s.offset, s.minVolts, s.maxVolts,
+                                                                    s.codeOffset, s.codeSlope);
+    const size_t actualCodesClipped = kernels.codes(samples.data(), actualCodes.data(), count,
+                                                    s.gain, s.offset, s.minVolts, s.maxVolts,
+                                                    s.codeOffset, s.codeSlope);
+
+    CHECK(expectedCodesClipped == actualCodesClipped, "%s codes: %zu samples, clipped %zu, expected %zu",
+          kernels.name, count, actualCodesClipped, expectedCodesClipped);
+    CHECK(expectedCodesClipped == expectedVoltsClipped, "scalar codes and volts disagree on clip count");
+
+    for (size_t i = 0; i <= count; ++i)
+        CHECK(expectedCodes[i] == actualCodes[i], "%s codes: %zu samples, [%zu] = %d, expected %d",
+              kernels.name, count, i, actualCodes[i], expectedCodes[i]);
+}
+
+static void test_scalar_reference()
+{
+    const float source[] = { -11.0f, -10.0f, 0.0f, 10.0f, 11.0f,
+                             std::numeric_limits<float>::quiet_NaN(),
+                             std::numeric_limits<float>::infinity(),
+                             -std::numeric_limits<float>::infinity() };
+    double volts[8];
+    int16_t codes[8];
+
+    // Exactly on the bounds is not a clip; beyond them, +-Inf and NaN are
+    CHECK(convert_to_volts_scalar(source, volts, 8, 1.0, 0.0, -10.0, 10.0) == 5, "scalar volts clip count");
+    CHECK(volts[0] == -10.0 && volts[1] == -10.0 && volts[2] == 0.0 && volts[3] == 10.0 && volts[4] == 10.0,
+          "scalar volts clamp");
+    CHECK(volts[5] == 0.0 && volts[6] == 10.0 && volts[7] == -10.0, "scalar volts non-finite input");
+
+    // A slope that maps +-10 V past the int16 range saturates; NaN becomes the code for 0 V
+    CHECK(convert_to_dac_codes_scalar(source, codes, 8, 1.0, 0.0, -10.0, 10.0, 0.5, 4000.0) == 5,
+          "scalar codes clip count");
+    CHECK(codes[0] == -32768 && codes[1] == -32768 && codes[2] == 0 && codes[3] == 32767 && codes[4] == 32767,
+          "scalar codes saturation");
+    CHECK(codes[5] == 0 && codes[6] == 32767 && codes[7] == -32768, "scalar codes non-finite input");
+}
+
+int main()
+{
+    test_scalar_reference();
+
+    std::vector<Kernels> kernels;
+#ifdef OUTPUT_KERNELS_X86
+    kernels.push_back({ "sse2", convert_to_volts_sse2, convert_to_dac_codes_sse2 });
+    if (cpu_has_avx2())
+        kernels.push_back({ "avx2", convert_to_volts_avx2, convert_to_dac_codes_avx2 });
+    else
+        std::printf("CPU has no AVX2, skipping the AVX2 kernels\n");
+#endif
+
+    const Scaling scalings[] = {
+        { 1.0, 0.0, -10.0, 10.0, 0.0, 3276.7 },        // +-10 V, full int16 range
+        { 0.5, 1.25, -5.0, 5.0, -12.0, 6553.4 },       // gain, offset and a code offset
+        { -2.0, 0.0, -10.0, 10.0, 3.0, 6553.4 },       // inverting; codes saturate before volts clip
+        { 0.0, 2.0, -10.0, 10.0, 0.0, 3276.7 },        // zero gain turns Inf into NaN
+        { 1.0, 0.0, 0.0, 0.0, 0.0, 3276.7 },           // degenerate range
+        { 1.0, 0.0, 1.0, 5.0, -6553.4, 6553.4 },       // 0 V outside the range: NaN goes to the low bound
+    };
+
+    std::mt19937 random(20190814);
+
+    for (const Scaling& scaling : scalings) {
+        for (size_t count = 0; count <= 67; ++count) {
+            const std::vector<float> samples = make_samples(count, random);
+            for (const Kernels& k : kernels)
+                compare(k, scaling, samples, count);
+        }
+
+        const std::vector<float> samples = make_samples(4099, random);
+        for (const Kernels& k : kernels)
+            compare(k, scaling, samples, samples.size());
+    }
+
+    if (failures == 0)
+        std::printf("All output kernel tests passed\n");
+
+    return failures == 0 ? 0 : 1;
+}
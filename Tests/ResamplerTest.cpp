@@ -0,0 +1,219 @@
+/*
+------------------------------------------------------------------
+
+This file is part of the Open Ephys GUI
+Copyright (C) 2019 Allen Institute for Brain Science and Open Ephys
+
+------------------------------------------------------------------
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+/* Checks the resampler on the exact (L/M) and interpolated phase banks,
+   including 30 kHz -> 40 kHz and 30 kHz -> 44.1 kHz and switching between
+   the banks with set_ratio_adjust(): the number of frames produced, unity
+   DC gain, where the output sits in time, and sine amplitude and phase. */
+
+#include "../Source/Resampler.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(condition, ...)                                  \
+    do {                                                       \
+        if (!(condition)) {                                    \
+            std::printf("FAILED %s:%d: ", __FILE__, __LINE__); \
+            std::printf(__VA_ARGS__);                          \
+            std::printf("\n");                                 \
+            ++failures;                                        \
+        }                                                      \
+    } while (0)
+
+static const double pi = 3.14159265358979323846;
+
+struct Conversion
+{
+    double inputRate;
+    double outputRate;
+    double adjust;          // set_ratio_adjust() before the first block
+    bool exact;             // which bank is expected to be in use
+};
+
+static const Conversion conversions[] = {
+    { 30000.0, 40000.0, 1.0, true },
+    { 30000.0, 44100.0, 1.0, true },
+    { 40000.0, 30000.0, 1.0, true },
+    { 30000.0, 30000.0, 1.0, true },
+    { 30000.0, 40000.5, 1.0, false },       // no L/M with L <= max_exact_phases
+    { 30000.0, 44100.0, 1.0002, false },    // drift trim
+};
+
+/* Input sample position of each output frame: output k sits at k * step */
+static double input_step(const Conversion& c)
+{
+    return c.inputRate / (c.outputRate * c.adjust);
+}
+
+/* Runs input through a new resampler in blocks of blockSize and returns the output */
+static std::vector<float> run(const Conversion& c, const std::vector<float>& input, int blockSize, Resampler** keep = nullptr)
+{
+    Resampler* resampler = new Resampler(c.inputRate, c.outputRate, 1, 512);
+    if (c.adjust != 1.0)
+        resampler->set_ratio_adjust(c.adjust);
+
+    std::vector<float> output(resampler->get_max_output(int(input.size())));
+    int numOutput = 0;
+
+    for (size_t start = 0; start < input.size(); start += blockSize) {
+        const int count = int(std::min(input.size() - start, size_t(blockSize)));
+        const float* in = input.data() + start;
+        float* out = output.data() + numOutput;
+        numOutput += resampler->process(&in, count, &out, int(output.size()) - numOutput);
+    }
+
+    output.resize(numOutput);
+
+    if (keep != nullptr)
+        *keep = resampler;
+    else
+        delete resampler;
+
+    return output;
+}
+
+static void test_conversion(const Conversion& c)
+{
+    const int numInput = 30000;
+    const double step = input_step(c);
+
+    Resampler* resampler;
+    std::vector<float> dc(numInput, 1.0f);
+    std::vector<float> output = run(c, dc, 300, &resampler);
+    const int latency = resampler->get_latency();
+
+    CHECK(resampler->uses_exact_phases() == c.exact, "%g -> %g Hz: exact bank %d, expected %d",
+          c.inputRate, c.outputRate, int(resampler->uses_exact_phases()), int(c.exact));
+    delete resampler;
+
+    // Output k needs input up to k * step + get_latency(); everything before that is produced
+    const double expectedLength = (numInput - latency) / step;
+    CHECK(std::fabs(output.size() - expectedLength) <= 1.0, "%g -> %g Hz: %zu frames, expected %.1f",
+          c.inputRate, c.outputRate, output.size(), expectedLength);
+
+    // The filter starts on zeros, so DC is only reached once its whole length is on the signal
+    double maxDCError = 0;
+    for (size_t k = size_t(2 * latency / step) + 1; k < output.size(); k++)
+        maxDCError = std::max(maxDCError, std::fabs(output[k] - 1.0));
+    CHECK(maxDCError < 1e-4, "%g -> %g Hz: DC gain off by %g", c.inputRate, c.outputRate, maxDCError);
+
+    // An impulse comes out at its own input position: the primed history takes up the
+    // filter delay, so get_latency() holds the output back without shifting it in time
+    const int impulseAt = 3001;
+    std::vector<float> impulse(numInput, 0.0f);
+    impulse[impulseAt] = 1.0f;
+    output = run(c, impulse, 300);
+
+    size_t peak = 0;
+    for (size_t k = 0; k < output.size(); k++)
+        if (output[k] > output[peak])
+            peak = k;
+
+    const double peakPosition = peak * step;
+    CHECK(std::fabs(peakPosition - impulseAt) <= step / 2 + 1e-9, "%g -> %g Hz: impulse at input %d peaks at input %.2f",
+          c.inputRate, c.outputRate, impulseAt, peakPosition);
+
+    // A frame comes out once the input sample at or before its position, and get_latency()
+    // more, have arrived: the first impulseAt + latency samples give every frame before the impulse
+    for (int extra = 0; extra <= 1; extra++) {
+        std::vector<float> head(impulse.begin(), impulse.begin() + impulseAt + latency + extra);
+        const size_t expected = size_t(std::ceil((impulseAt + extra) / step - 1e-9));
+        CHECK(run(c, head, 300).size() == expected, "%g -> %g Hz: frames produced from %d + %d samples, expected %zu",
+              c.inputRate, c.outputRate, impulseAt + extra, latency, expected);
+    }
+
+    // A 1 kHz sine, well inside the passband, keeps its amplitude and phase
+    const double frequency = 1000.0;
+    std::vector<float> sine(numInput);
+    for (int i = 0; i < numInput; i++)
+        sine[i] = float(std::sin(2.0 * pi * frequency * i / c.inputRate));
+    output = run(c, sine, 300);
+
+    double maxSineError = 0;
+    for (size_t k = size_t(2 * latency / step) + 1; k < output.size(); k++)
+        maxSineError = std::max(maxSineError, std::fabs(output[k] - std::sin(2.0 * pi * frequency * k * step / c.inputRate)));
+    CHECK(maxSineError < 1e-4, "%g -> %g Hz (adjust %g): sine off by %g", c.inputRate, c.outputRate, c.adjust, maxSineError);
+}
+
+/* Trimming the ratio switches to the interpolated bank and back without a jump */
+static void test_ratio_adjust_switch()
+{
+    const double inputRate = 30000.0;
+    const double outputRate = 44100.0;
+    const double frequency = 1000.0;
+    const int blockSize = 300;
+
+    Resampler resampler(inputRate, outputRate, 1, 512);
+    CHECK(resampler.uses_exact_phases(), "switch: starts on the exact bank");
+
+    std::vector<float> output(2000);
+    double position = 0;
+    double maxError = 0;
+    int numOutput = 0;
+
+    for (int block = 0; block < 90; block++) {
+        if (block == 30)
+            resampler.set_ratio_adjust(1.0005);
+        if (block == 60)
+            resampler.set_ratio_adjust(1.0);
+
+        std::vector<float> input(blockSize);
+        for (int i = 0; i < blockSize; i++)
+            input[i] = float(std::sin(2.0 * pi * frequency * (block * blockSize + i) / inputRate));
+
+        const float* in = input.data();
+        float* out = output.data();
+        const int produced = resampler.process(&in, blockSize, &out, int(output.size()));
+
+        // Outputs of a block all use the step in force when it was processed
+        const double step = inputRate / (outputRate * resampler.get_ratio_adjust());
+        for (int k = 0; k < produced; k++, numOutput++, position += step)
+            if (position > 2.0 * resampler.get_latency())
+                maxError = std::max(maxError, std::fabs(output[k] - std::sin(2.0 * pi * frequency * position / inputRate)));
+
+        if (block == 30)
+            CHECK(!resampler.uses_exact_phases(), "switch: a trimmed ratio uses the interpolated bank");
+        if (block == 60)
+            CHECK(resampler.uses_exact_phases(), "switch: an untrimmed ratio goes back to the exact bank");
+    }
+
+    // Going back to the exact bank rounds the position to the nearest of its 147 phases
+    CHECK(maxError < 2e-3, "switch: sine off by %g across bank changes", maxError);
+}
+
+int main()
+{
+    for (const Conversion& c : conversions)
+        test_conversion(c);
+
+    test_ratio_adjust_switch();
+
+    if (failures == 0)
+        std::printf("All resampler tests passed\n");
+
+    return failures == 0 ? 0 : 1;
+}